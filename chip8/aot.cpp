@@ -0,0 +1,154 @@
+#include "aot.h"
+
+#include "chip8.h"
+
+#include <algorithm>
+
+namespace emu
+{
+
+Aot::Registration::Registration(const Program& program)
+{
+    programs().push_back(&program);
+}
+
+std::vector<const Aot::Program*>& Aot::programs()
+{
+    /* function local: generated files register during static initialization, in any order */
+    static std::vector<const Program*> programs;
+    return programs;
+}
+
+void Aot::exec(State& state, uint16 pc)
+{
+    const auto& decoded = state.chip8->m_decoded[pc >> 1];
+    decoded.m_exec(*state.chip8, decoded.m_op_code);
+}
+
+
+Aot::Aot(const Chip8& chip8)
+{
+    m_index.resize(Chip8::memory_size / 2, 0);
+    m_covered.resize(Chip8::memory_size, 0);
+
+    /* the program whose blocks match memory best (a rom may already have written into its own image) */
+    std::size_t best = 0;
+    for(const auto* program : programs())
+    {
+        if(program->m_rom_size > Chip8::end_addr - Chip8::start_addr) continue;
+
+        std::size_t matching = 0;
+        for(uint32 i = 0; i < program->m_block_count; i++) matching += program->m_blocks[i].m_end <= Chip8::memory_size &&
+                                                                        matches(chip8, *program, program->m_blocks[i]);
+
+        if(matching > best)
+        {
+            best = matching;
+            m_program = program;
+        }
+    }
+
+    if(!m_program) return;
+
+    m_valid.resize(m_program->m_block_count, 0);
+    for(uint32 i = 0; i < m_program->m_block_count; i++)
+    {
+        const auto& block = m_program->m_blocks[i];
+        if(block.m_end > Chip8::memory_size || (block.m_start & 0x1)) continue;
+
+        m_index[block.m_start >> 1] = static_cast<uint16>(i + 1);
+        m_valid[i] = matches(chip8, *m_program, block);
+        for(uint32 a = block.m_start; a < block.m_end; a++) m_covered[a] = 1;
+    }
+}
+
+const Aot::Program* Aot::program() const
+{
+    return m_program;
+}
+
+int Aot::execute(Chip8& chip8, int cycles)
+{
+    if(!m_program || chip8.m_quirks != m_program->m_quirks) return chip8.execute_threaded(cycles);
+
+    State state
+    {
+        chip8.m_register.V.data(), &chip8.m_register.I, &chip8.m_register.PC, &chip8.m_register.SP,
+        chip8.m_stack.data(), &chip8.m_register.timer_delay, &chip8.m_register.timer_sound,
+        chip8.m_keypad.data(), chip8.m_memory.data(), &chip8
+    };
+
+    /* FX0A is always interpreted, so only a step can start waiting */
+    const auto step = [&chip8, &cycles]()
+    {
+        chip8.step();
+        cycles--;
+        return !chip8.m_await_interrupt;
+    };
+
+    while(cycles > 0)
+    {
+        const auto pc = chip8.m_register.PC;
+        const auto index = (pc & 0x1) || pc >= Chip8::memory_size - 1 ? 0 : m_index[pc >> 1];
+
+        /* no (unmodified) block starts here, or it would overrun the budget: interpret single instructions */
+        if(index == 0 || !m_valid[index - 1] || m_program->m_blocks[index - 1].m_count > cycles)
+        {
+            if(!step()) break;
+            continue;
+        }
+
+        const auto& block = m_program->m_blocks[index - 1];
+        if constexpr(Chip8::profiling)
+        {
+            for(uint32 addr = pc, i = 0; i < block.m_count; i++)
+            {
+                const auto& decoded = chip8.m_decoded[addr >> 1];
+                chip8.m_profile->count(addr, decoded);
+                addr += decoded.m_code == detail::eCode::_F000 ? 4 : 2;
+            }
+        }
+
+        /* a block runs all of its instructions (control flow only at its end) */
+        cycles -= block.m_count;
+        block.m_code(state);
+    }
+
+    return std::max(cycles, 0);
+}
+
+void Aot::invalidate(const Chip8& chip8, uint16 addr, uint32 size)
+{
+    if(!m_program) return;
+
+    const uint32 end = std::min<uint32>(uint32(addr) + size, Chip8::memory_size);
+
+    bool covered = false;
+    for(uint32 a = addr; a < end && !covered; a++) covered = m_covered[a] != 0;
+    if(!covered) return;
+
+    /* a write that restores the translated bytes makes a block valid again */
+    for(uint32 i = 0; i < m_program->m_block_count; i++)
+    {
+        const auto& block = m_program->m_blocks[i];
+        if(block.m_start < end && block.m_end > addr && m_index[block.m_start >> 1] == i + 1)
+        {
+            m_valid[i] = matches(chip8, *m_program, block);
+        }
+    }
+}
+
+bool Aot::matches(const Chip8& chip8, const Program& program, const Block& block)
+{
+    /* memory past the rom image is zero after loading */
+    for(uint32 a = block.m_start; a < block.m_end; a++)
+    {
+        const uint32 offset = a - Chip8::start_addr;
+        const uint8 expected = a >= Chip8::start_addr && offset < program.m_rom_size ? program.m_rom[offset] : 0;
+        if(chip8.m_memory[a] != expected) return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "base.h"
+
+#include <vector>
+
+namespace emu
+{
+
+struct Chip8;
+
+/*
+ *  Chip8 Ahead-of-Time Translated Programs:
+ *  -----------------------------
+ *    -> chip-8-aot translates a rom into a C++ file: control flow is followed from start_addr (jumps, calls,
+ *       return addresses, both sides of every skip) and each basic block becomes one function
+ *    -> blocks end and start like the ones of the JIT (jit.h): control flow and memory writes end a block,
+ *       FX0A, 00FD and unknown opcodes are left to the interpreter
+ *    -> a block loads the V registers it uses into locals, the interpreter handlers it calls (DXYN, CXNN, FX33, FX55,
+ *       SUPER-CHIP / XO-CHIP opcodes) see the registers written back
+ *    -> the generated file registers its Program at static initialization, linking it into a front end is enough
+ *       (CMake: CHIP8_AOT_ROMS builds chip-8-headless per rom)
+ *
+ *  Runtime (CORE_AOT):
+ *  -----------------------------
+ *    -> picks the registered program matching most of memory when the core is first used (or after load_rom)
+ *    -> a block runs only while memory still holds the bytes it was translated from (self-modifying code and
+ *       code reached only through BNNN, or not found by the translator, are interpreted)
+ *    -> without a matching program, or with other quirks than the program was translated for, it runs the
+ *       threaded core
+ *
+ *  -----------------------------
+ */
+struct Aot
+{
+    /* Chip8 state seen by the generated blocks (points into the Chip8 object) */
+    struct State
+    {
+        uint8* V;
+        uint16* I;
+        uint16* PC;
+        uint16* SP;
+        uint16* stack;
+        uint8* delay;
+        uint8* sound;
+        const bool* keypad;
+        uint8* memory;
+        Chip8* chip8;
+    };
+
+    using BlockFn = void (*)(State& state);
+
+    struct Block
+    {
+        uint16 m_start;
+        uint32 m_end;               /* first address after the translated range */
+        uint8 m_count;              /* instructions executed by the block */
+        BlockFn m_code;
+    };
+
+    /* one translated rom (emitted by chip-8-aot) */
+    struct Program
+    {
+        const char* m_name;
+        const uint8* m_rom;         /* loaded at start_addr */
+        uint32 m_rom_size;
+        uint8 m_quirks;             /* Chip8::eQuirk bitmask the blocks are specialized for */
+        const Block* m_blocks;
+        uint32 m_block_count;
+    };
+
+    /* adds a program to programs() (a static object in the generated file) */
+    struct Registration
+    {
+        explicit Registration(const Program& program);
+    };
+
+    static std::vector<const Program*>& programs();
+
+    /* interpreter handler of the (unmodified) instruction at pc, called by the generated blocks */
+    static void exec(State& state, uint16 pc);
+
+public:
+    explicit Aot(const Chip8& chip8);
+    Aot(const Aot&) = delete;
+    Aot& operator=(const Aot&) = delete;
+
+    /* nullptr if no registered program matches */
+    const Program* program() const;
+
+    /* run cycles instructions; returns the instructions left when FX0A starts waiting */
+    int execute(Chip8& chip8, int cycles);
+
+    /* re-check the blocks overlapping [addr, addr + size) against the program */
+    void invalidate(const Chip8& chip8, uint16 addr, uint32 size);
+
+private:
+    /* memory holds the bytes block was translated from */
+    static bool matches(const Chip8& chip8, const Program& program, const Block& block);
+
+private:
+    const Program* m_program = nullptr;
+    std::vector<uint16> m_index;        /* per even address: block index + 1 (0: none starts there) */
+    std::vector<uint8> m_valid;         /* per block */
+    std::vector<uint8> m_covered;       /* per byte: translated by any block */
+};
+
+}
@@ -0,0 +1,581 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+namespace emu
+{
+
+namespace detail
+{
+
+/* bit of each lane in a group mask (table lookup instead of a variable shift keeps lane loops vectorizable) */
+constexpr auto lane_bits = []()
+{
+    std::array<uint32, 32> bits;
+    for(uint32 l = 0; l < bits.size(); l++)
+    {
+        bits[l] = uint32(1) << l;
+    }
+    return bits;
+}();
+
+}
+
+template<std::size_t N>
+Chip8Batch<N>::Chip8Batch()
+    : m_lanes(N)
+{
+    m_written.fill(false);
+
+    for(std::size_t l = 0; l < N; l++)
+    {
+        load(l);
+    }
+}
+
+template<std::size_t N>
+bool Chip8Batch<N>::load_rom(const std::filesystem::path& path)
+{
+    if(!std::filesystem::exists(path))
+    {
+        std::cerr << "[Chip8Batch::load_rom] Rom " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8> code(std::istreambuf_iterator<char>(file), {});
+    return load_rom(code);
+}
+
+template<std::size_t N>
+bool Chip8Batch<N>::load_rom(const std::vector<uint8>& code)
+{
+    for(std::size_t l = 0; l < N; l++)
+    {
+        if(!m_lanes[l].load_rom(code)) return false;
+        load(l);
+    }
+
+    m_written.fill(false);
+    return true;
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::execute_cycle()
+{
+    select_quirks();
+    step();
+
+    for(std::size_t l = 0; l < N; l++)
+    {
+        sync(l);
+    }
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::tick()
+{
+    select_quirks();
+
+    for(int i = 0; i < m_settings.m_cycles; i++)
+    {
+        step();
+    }
+
+    /* timer tick of all lanes */
+    for(std::size_t l = 0; l < N; l++)
+    {
+        m_delay[l] -= m_delay[l] > 0;
+        m_sound[l] -= m_sound[l] > 0;
+    }
+
+    for(std::size_t l = 0; l < N; l++)
+    {
+        sync(l);
+    }
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::step()
+{
+    constexpr uint32 all = N == 32 ? ~uint32(0) : (uint32(1) << N) - 1;
+
+    m_stats.m_steps++;
+
+    uint32 pending = all;
+    while(pending)
+    {
+        const auto leader = std::countr_zero(pending);
+        const uint16 pc = m_PC[leader];
+
+        /* odd (or out of memory) program counter: the lane runs on its own */
+        if((pc & 0x1) || pc >= Chip8::memory_size)
+        {
+            pending &= ~(uint32(1) << leader);
+            execute_scalar(leader);
+            continue;
+        }
+
+        /* group all pending lanes at the same address */
+        uint32 group = 0;
+        for(std::size_t l = 0; l < N; l++)
+        {
+            group |= (uint32(0) - uint32(m_PC[l] == pc)) & detail::lane_bits[l];
+        }
+        group &= pending;
+
+        /* ... holding the same opcode (only differs where lanes have written memory) */
+        if(m_written[pc >> 1])
+        {
+            const auto& memory = m_lanes[leader].m_memory;
+            for(uint32 bits = group; bits; bits &= bits - 1)
+            {
+                const auto l = std::countr_zero(bits);
+                const auto& lane = m_lanes[l].m_memory;
+
+                if(lane[pc] != memory[pc] || lane[pc + 1] != memory[pc + 1]) group &= ~(uint32(1) << l);
+            }
+        }
+        pending &= ~group;
+
+        if(group == all) m_stats.m_converged++;
+
+        if(execute_group(m_lanes[leader].m_decoded[pc >> 1], group))
+        {
+            m_stats.m_groups++;
+            continue;
+        }
+
+        for(uint32 bits = group; bits; bits &= bits - 1)
+        {
+            execute_scalar(std::countr_zero(bits));
+        }
+    }
+}
+
+template<std::size_t N>
+bool Chip8Batch<N>::execute_group(const Instruction::Decoded& decoded, uint32 group)
+{
+    using detail::eCode;
+
+    const auto& op = decoded.m_op_code;
+    const auto quirks = m_settings.quirks();
+
+    /* blend masks (all bits set for lanes of the group) */
+    alignas(32) Lane8 mask8;
+    alignas(32) Lane16 mask16;
+    for(std::size_t l = 0; l < N; l++)
+    {
+        mask8[l] = (group & detail::lane_bits[l]) ? 0xFF : 0x00;
+        mask16[l] = (group & detail::lane_bits[l]) ? 0xFFFF : 0x0000;
+    }
+
+    /* reg[l] = value(l) on lanes of the group (value is evaluated before the store, lane loops vectorize) */
+    const auto set8 = [&](Lane8& reg, auto&& value)
+    {
+        for(std::size_t l = 0; l < N; l++)
+        {
+            reg[l] = (uint8(value(l)) & mask8[l]) | (reg[l] & ~mask8[l]);
+        }
+    };
+
+    const auto set16 = [&](Lane16& reg, auto&& value)
+    {
+        for(std::size_t l = 0; l < N; l++)
+        {
+            reg[l] = (uint16(value(l)) & mask16[l]) | (reg[l] & ~mask16[l]);
+        }
+    };
+
+    /* per lane loop over the lanes of the group */
+    const auto for_group = [&](auto&& func)
+    {
+        for(uint32 bits = group; bits; bits &= bits - 1)
+        {
+            func(std::countr_zero(bits));
+        }
+    };
+
+    auto& vx = m_V[op.x()];
+    auto& vy = m_V[op.y()];
+    auto& vf = m_V[0xF];
+    auto& v0 = m_V[0x0];
+
+    /* XO-CHIP: a taken skip jumps over 2 or 4 bytes, read per lane (lanes may have written the next instruction) */
+    const auto advance = [&](auto&& skip)
+    {
+        if constexpr(Chip8::xo_chip) set16(m_PC, [&](std::size_t l) { return m_PC[l] + 2 + m_lanes[l].skip_size(m_PC[l]) * skip(l); });
+        else set16(m_PC, [&](std::size_t l) { return m_PC[l] + 2 + 2 * skip(l); });
+    };
+    const auto next = [&]() { advance([](std::size_t) { return 0; }); };
+
+    switch(decoded.m_code)
+    {
+    case eCode::_1NNN:
+        set16(m_PC, [&](std::size_t) { return op.nnn(); });
+        return true;
+
+    case eCode::_3XNN:
+        advance([&](std::size_t l) { return vx[l] == op.nn(); });
+        return true;
+
+    case eCode::_4XNN:
+        advance([&](std::size_t l) { return vx[l] != op.nn(); });
+        return true;
+
+    case eCode::_5XY0:
+        advance([&](std::size_t l) { return vx[l] == vy[l]; });
+        return true;
+
+    case eCode::_9XY0:
+        advance([&](std::size_t l) { return vx[l] != vy[l]; });
+        return true;
+
+    case eCode::_6XNN:
+        set8(vx, [&](std::size_t) { return op.nn(); });
+        next();
+        return true;
+
+    case eCode::_7XNN:
+        set8(vx, [&](std::size_t l) { return vx[l] + op.nn(); });
+        next();
+        return true;
+
+    case eCode::_8XY0:
+        set8(vx, [&](std::size_t l) { return vy[l]; });
+        next();
+        return true;
+
+    case eCode::_8XY1:
+        set8(vx, [&](std::size_t l) { return vx[l] | vy[l]; });
+        if(quirks & Chip8::QUIRK_VF_RESET) set8(vf, [](std::size_t) { return 0; });
+        next();
+        return true;
+
+    case eCode::_8XY2:
+        set8(vx, [&](std::size_t l) { return vx[l] & vy[l]; });
+        if(quirks & Chip8::QUIRK_VF_RESET) set8(vf, [](std::size_t) { return 0; });
+        next();
+        return true;
+
+    case eCode::_8XY3:
+        set8(vx, [&](std::size_t l) { return vx[l] ^ vy[l]; });
+        if(quirks & Chip8::QUIRK_VF_RESET) set8(vf, [](std::size_t) { return 0; });
+        next();
+        return true;
+
+    /* flag first, then the result from the (possibly overwritten) operands, as in instruction.cpp */
+    case eCode::_8XY4:
+        set8(vf, [&](std::size_t l) { return vy[l] > (0xFF - vx[l]); });
+        set8(vx, [&](std::size_t l) { return vx[l] + vy[l]; });
+        next();
+        return true;
+
+    case eCode::_8XY5:
+        set8(vf, [&](std::size_t l) { return !(vy[l] >= vx[l]); });
+        set8(vx, [&](std::size_t l) { return vx[l] - vy[l]; });
+        next();
+        return true;
+
+    case eCode::_8XY7:
+        set8(vf, [&](std::size_t l) { return vx[l] <= vy[l]; });
+        set8(vx, [&](std::size_t l) { return vy[l] - vx[l]; });
+        next();
+        return true;
+
+    case eCode::_8XY6:
+    {
+        auto& src = (quirks & Chip8::QUIRK_SHIFTING) ? vx : vy;
+        set8(vf, [&](std::size_t l) { return src[l] & 0x1; });
+        set8(vx, [&](std::size_t l) { return src[l] >> 1; });
+        next();
+        return true;
+    }
+
+    case eCode::_8XYE:
+    {
+        auto& src = (quirks & Chip8::QUIRK_SHIFTING) ? vx : vy;
+        set8(vf, [&](std::size_t l) { return src[l] >> 7; });
+        set8(vx, [&](std::size_t l) { return src[l] << 1; });
+        next();
+        return true;
+    }
+
+    case eCode::_ANNN:
+        set16(m_I, [&](std::size_t) { return op.nnn(); });
+        next();
+        return true;
+
+    case eCode::_BNNN:
+    {
+        auto& base = (quirks & Chip8::QUIRK_JUMPING) ? vx : v0;
+        set16(m_PC, [&](std::size_t l) { return base[l] + op.nnn(); });
+        return true;
+    }
+
+    /* keypad lookup is a gather from the lane machines */
+    case eCode::_EX9E:
+        advance([&](std::size_t l) { return ((group >> l) & 0x1) && m_lanes[l].m_keypad[vx[l]]; });
+        return true;
+
+    case eCode::_EXA1:
+        advance([&](std::size_t l) { return ((group >> l) & 0x1) && !m_lanes[l].m_keypad[vx[l]]; });
+        return true;
+
+    case eCode::_FX07:
+        set8(vx, [&](std::size_t l) { return m_delay[l]; });
+        next();
+        return true;
+
+    case eCode::_FX15:
+        set8(m_delay, [&](std::size_t l) { return vx[l]; });
+        next();
+        return true;
+
+    case eCode::_FX18:
+        set8(m_sound, [&](std::size_t l) { return vx[l]; });
+        next();
+        return true;
+
+    case eCode::_FX1E:
+        set16(m_I, [&](std::size_t l) { return m_I[l] + vx[l]; });
+        next();
+        return true;
+
+    case eCode::_FX29:
+        set16(m_I, [&](std::size_t l) { return vx[l] * 0x5; });
+        next();
+        return true;
+
+    /* memory, display and stack: one lane after another on the lane machines (no full register sync) */
+    case eCode::_00E0:
+        for_group([&](std::size_t l) { m_lanes[l].m_display.clear(); });
+        next();
+        return true;
+
+    case eCode::_00EE:
+        for_group([&](std::size_t l)
+        {
+            auto& lane = m_lanes[l];
+            lane.m_register.SP--;
+            m_PC[l] = lane.m_stack[lane.m_register.SP] + 2;
+        });
+        return true;
+
+    case eCode::_2NNN:
+        for_group([&](std::size_t l)
+        {
+            auto& lane = m_lanes[l];
+            lane.m_stack[lane.m_register.SP] = m_PC[l];
+            lane.m_register.SP++;
+            m_PC[l] = op.nnn();
+        });
+        return true;
+
+    case eCode::_DXYN:
+        for_group([&](std::size_t l) { vf[l] = m_lanes[l].draw_sprite(vx[l], vy[l], m_I[l], op.n()); });
+        next();
+        return true;
+
+    case eCode::_FX33:
+        for_group([&](std::size_t l)
+        {
+            auto& lane = m_lanes[l];
+            const auto value = vx[l];
+            const auto addr = m_I[l];
+
+            lane.m_memory[ (addr + 0) & Chip8::memory_mask ] = value / 100;
+            lane.m_memory[ (addr + 1) & Chip8::memory_mask ] = (value / 10) % 10;
+            lane.m_memory[ (addr + 2) & Chip8::memory_mask ] = (value % 100) % 10;
+            lane.invalidate(addr, 3);
+            written(addr, 3);
+        });
+        next();
+        return true;
+
+    case eCode::_FX55:
+        for_group([&](std::size_t l)
+        {
+            auto& lane = m_lanes[l];
+            const auto addr = m_I[l];
+
+            for(int i = 0; i <= op.x(); i++)
+            {
+                lane.m_memory[ (addr + i) & Chip8::memory_mask ] = m_V[i][l];
+            }
+            lane.invalidate(addr, op.x() + 1);
+            written(addr, op.x() + 1);
+        });
+        if(quirks & Chip8::QUIRK_MEMORY) set16(m_I, [&](std::size_t l) { return m_I[l] + op.x() + 1; });
+        next();
+        return true;
+
+    case eCode::_FX65:
+        for_group([&](std::size_t l)
+        {
+            const auto& lane = m_lanes[l];
+            const auto addr = m_I[l];
+
+            for(int i = 0; i <= op.x(); i++)
+            {
+                m_V[i][l] = lane.m_memory[ (addr + i) & Chip8::memory_mask ];
+            }
+        });
+        if(quirks & Chip8::QUIRK_MEMORY) set16(m_I, [&](std::size_t l) { return m_I[l] + op.x() + 1; });
+        next();
+        return true;
+
+    case eCode::_CXNN:
+        for_group([&](std::size_t l) { vx[l] = (m_lanes[l].random() % 0xFF) & op.nn(); });
+        next();
+        return true;
+
+    /* waiting lanes stay on the instruction */
+    case eCode::_FX0A:
+        for_group([&](std::size_t l)
+        {
+            auto& lane = m_lanes[l];
+            lane.m_await_interrupt = true;
+
+            for(unsigned int i = 0; i < lane.m_keypad.size(); i++)
+            {
+                if(lane.m_keypad[i])
+                {
+                    vx[l] = i;
+                    lane.m_await_interrupt = false;
+                }
+            }
+
+            m_PC[l] += lane.m_await_interrupt ? 0 : 2;
+        });
+        return true;
+
+    /* unknown opcodes run through the lane handlers */
+    default:
+        return false;
+    }
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::execute_scalar(std::size_t lane)
+{
+    m_stats.m_scalar_lanes++;
+
+    /* memory writes of the handler (only reachable from odd addresses, FX33 and FX55 are group operations otherwise;
+     * XO-CHIP 5XY2 always runs here) */
+    const auto pc = m_PC[lane];
+    const auto& memory = m_lanes[lane].m_memory;
+    if(pc < Chip8::memory_size - 1 && (memory[pc] & 0xF0) == 0xF0)
+    {
+        if(memory[pc + 1] == 0x33) written(m_I[lane], 3);
+        if(memory[pc + 1] == 0x55) written(m_I[lane], (memory[pc] & 0x0F) + 1);
+    }
+    if(Chip8::xo_chip && pc < Chip8::memory_size - 1 && (memory[pc] & 0xF0) == 0x50 && (memory[pc + 1] & 0x0F) == 0x2)
+    {
+        const int x = memory[pc] & 0x0F;
+        const int y = memory[pc + 1] >> 4;
+        written(m_I[lane], (x <= y ? y - x : x - y) + 1);
+    }
+
+    sync(lane);
+    m_lanes[lane].step();
+    load(lane);
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::written(uint16 addr, uint16 size)
+{
+    /* wraps around the end of memory like the write */
+    addr &= Chip8::memory_mask;
+    if(addr + size > Chip8::memory_size)
+    {
+        written(0, addr + size - Chip8::memory_size);
+        size = Chip8::memory_size - addr;
+    }
+
+    const uint32 end = std::min<uint32>(uint32(addr) + size, Chip8::memory_size);
+    for(uint32 a = addr & ~0x1u; a < end; a += 2)
+    {
+        m_written[a >> 1] = true;
+    }
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::select_quirks()
+{
+    for(auto& lane : m_lanes)
+    {
+        lane.m_settings = m_settings;
+        lane.select_quirks();
+    }
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::sync(std::size_t lane)
+{
+    auto& regs = m_lanes[lane].m_register;
+
+    for(int i = 0; i < 16; i++)
+    {
+        regs.V[i] = m_V[i][lane];
+    }
+    regs.I = m_I[lane];
+    regs.PC = m_PC[lane];
+    regs.timer_delay = m_delay[lane];
+    regs.timer_sound = m_sound[lane];
+}
+
+template<std::size_t N>
+void Chip8Batch<N>::load(std::size_t lane)
+{
+    const auto& regs = m_lanes[lane].m_register;
+
+    for(int i = 0; i < 16; i++)
+    {
+        m_V[i][lane] = regs.V[i];
+    }
+    m_I[lane] = regs.I;
+    m_PC[lane] = regs.PC;
+    m_delay[lane] = regs.timer_delay;
+    m_sound[lane] = regs.timer_sound;
+}
+
+template<std::size_t N>
+const Chip8& Chip8Batch<N>::lane(std::size_t i) const
+{
+    return m_lanes[i];
+}
+
+template<std::size_t N>
+Chip8::Keypad& Chip8Batch<N>::keypad(std::size_t i)
+{
+    return m_lanes[i].m_keypad;
+}
+
+template<std::size_t N>
+Chip8::Settings& Chip8Batch<N>::settings()
+{
+    return m_settings;
+}
+
+template<std::size_t N>
+const Chip8::Settings& Chip8Batch<N>::settings() const
+{
+    return m_settings;
+}
+
+template<std::size_t N>
+const typename Chip8Batch<N>::Stats& Chip8Batch<N>::stats() const
+{
+    return m_stats;
+}
+
+template struct Chip8Batch<8>;
+template struct Chip8Batch<16>;
+template struct Chip8Batch<32>;
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Lockstep Batch:
+ *  -----------------------------
+ *    -> runs N independent machines (N = 8, 16, 32) instruction by instruction in lockstep
+ *    -> V, I, PC and the timers are stored as structure of arrays (one array of N lanes per register)
+ *    -> lanes at the same PC with the same opcode form a group and execute together:
+ *         - register only opcodes (6XNN, 7XNN, 8XYN, ANNN, skips, jumps, timers, ...) run as fixed width
+ *           lane loops with a blend mask (vectorized to SSE2 / AVX2 by the compiler)
+ *         - display, stack, memory, random and key wait opcodes (DXYN, 2NNN, 00EE, FX33, FX55, CXNN, FX0A, ...)
+ *           loop over the lanes of the group, directly on the lane machines
+ *         - unknown opcodes and odd addresses run per lane through the Chip8 handlers of instruction.cpp
+ *           (registers are synced to the lane machine around the call)
+ *    -> divergent lanes are regrouped every step; when all lanes run the same ROM on similar input
+ *       there is usually a single group
+ *
+ *    Memory, display, keypad and stack live in one Chip8 per lane (lane(i)), its registers are synced after each tick.
+ *
+ *  -----------------------------
+ */
+template<std::size_t N>
+struct Chip8Batch
+{
+    static_assert(N == 8 || N == 16 || N == 32, "Chip8Batch supports 8, 16 or 32 lanes");
+
+    static constexpr std::size_t lanes = N;
+
+    /* lockstep statistics */
+    struct Stats
+    {
+        uint64 m_steps = 0;             /* lockstep instruction steps */
+        uint64 m_converged = 0;         /* steps where all lanes formed a single group */
+        uint64 m_groups = 0;            /* groups executed on the structure of arrays */
+        uint64 m_scalar_lanes = 0;      /* lane instructions executed by the handlers */
+    };
+
+public:
+    Chip8Batch();
+
+    /* load the same rom into all lanes */
+    bool load_rom(const std::filesystem::path& path);
+    bool load_rom(const std::vector<uint8>& code);
+
+    /* one lockstep instruction on all lanes */
+    void execute_cycle();
+
+    /* should be called at 60hz (runs settings().m_cycles lockstep instructions and the timers of all lanes) */
+    void tick();
+
+    /* per lane machine (registers valid after tick) and input */
+    const Chip8& lane(std::size_t i) const;
+    Chip8::Keypad& keypad(std::size_t i);
+
+    /* settings shared by all lanes */
+    Chip8::Settings& settings();
+    const Chip8::Settings& settings() const;
+
+    const Stats& stats() const;
+
+private:
+    using Lane8 = std::array<uint8, N>;
+    using Lane16 = std::array<uint16, N>;
+
+    /* one lockstep instruction (lanes are regrouped by program counter and opcode) */
+    void step();
+
+    /* copy the shared settings into the lane machines (selects their quirk handlers) */
+    void select_quirks();
+
+    /* execute one group (bitmask of lanes) on the structure of arrays, false if it has to run through the lane handlers */
+    bool execute_group(const Instruction::Decoded& decoded, uint32 group);
+
+    /* execute one instruction on a single lane through its Chip8 */
+    void execute_scalar(std::size_t lane);
+
+    /* mark memory written by some lanes (the opcodes there may differ between lanes) */
+    void written(uint16 addr, uint16 size);
+
+    /* copy the structure of arrays registers into (sync) / out of (load) a lane machine */
+    void sync(std::size_t lane);
+    void load(std::size_t lane);
+
+private:
+    alignas(32) std::array<Lane8, 16> m_V;
+    alignas(32) Lane16 m_I;
+    alignas(32) Lane16 m_PC;
+    alignas(32) Lane8 m_delay;
+    alignas(32) Lane8 m_sound;
+
+    std::vector<Chip8> m_lanes;
+
+    /* per even address: written by a lane since the rom was loaded (otherwise all lanes hold the same opcode) */
+    std::array<bool, Chip8::memory_size / 2> m_written;
+
+    Chip8::Settings m_settings;
+    Stats m_stats;
+};
+
+extern template struct Chip8Batch<8>;
+extern template struct Chip8Batch<16>;
+extern template struct Chip8Batch<32>;
+
+}
@@ -1,8 +1,12 @@
 #include "chip8.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <fstream>
+#include <string>
 #include <vector>
 
 namespace emu
@@ -32,6 +36,94 @@ constexpr std::array<uint8, 80> fontset =
     0xF0, 0x80, 0xF0, 0x80, 0x80
 };
 
+/* SUPER-CHIP big font (8x10 digits, loaded at big_font_addr) */
+constexpr std::array<uint8, 160> big_fontset =
+{
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C,
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C,
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF,
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C,
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06,
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C,
+    0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C,
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60,
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C,
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C,
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0
+};
+static_assert(Chip8::big_font_addr >= Chip8::font_addr + fontset.size());
+
+/* longest idle loop (instructions per iteration) */
+constexpr int idle_length = 8;
+
+/* draws height sprite rows from addr at (vx, vy) into a plane of the packed display, returns 1 on collision
+ * (Wide: 16 pixels from two bytes per row; Hires: the row spans two columns, the sprite may straddle them) */
+template<bool Hires, bool Wide>
+uint8 draw(Chip8::Display& display, Chip8::Display::Plane& plane, const Chip8::Memory& memory, uint8 vx, uint8 vy, uint16 addr, int height)
+{
+    using Word = Chip8::Display::Word;
+
+    constexpr int width = Hires ? Chip8::max_width_res : Chip8::width_res;
+    constexpr int lines = Hires ? Chip8::max_height_res : Chip8::height_res;
+
+    const int x = vx % width;
+    const int y = vy % lines;
+    const int rows = std::min<int>(height, lines - y);
+
+    Word collision = 0;
+    uint64 changed = 0;
+    for(int i = 0; i < rows; i++)
+    {
+        /* sprite row at the left end of a word, shifted into place (bits past the right edge drop out) */
+        const auto byte = [&memory, addr](int offset) { return Word(memory[(addr + offset) & Chip8::memory_mask]); };
+        const Word bits = Wide ? byte(2 * i) << 56 | byte(2 * i + 1) << 48 : byte(i) << 56;
+        auto& word = plane[0][y + i];
+
+        if constexpr(Hires)
+        {
+            const Word left = x < 64 ? bits >> x : 0;
+            const Word right = x == 0 ? 0 : x < 64 ? bits << (64 - x) : bits >> (x - 64);
+            auto& next = plane[1][y + i];
+
+            collision |= (word & left) | (next & right);
+            word ^= left;
+            next ^= right;
+            changed |= uint64((left | right) != 0) << (y + i);
+        }
+        else
+        {
+            const Word sprite = bits >> x;
+
+            collision |= word & sprite;
+            word ^= sprite;
+            changed |= uint64(sprite != 0) << (y + i);
+        }
+    }
+
+    display.changed(changed);
+    return collision != 0;
+}
+
+/* instructions that only read state or write registers (an idle loop consists of these only) */
+constexpr bool pure(eCode code)
+{
+    switch(code)
+    {
+    case _1NNN: case _3XNN: case _4XNN: case _5XY0: case _6XNN: case _7XNN:
+    case _8XY0: case _8XY1: case _8XY2: case _8XY3: case _8XY4: case _8XY5: case _8XY6: case _8XY7: case _8XYE:
+    case _9XY0: case _ANNN: case _BNNN: case _EX9E: case _EXA1: case _FX07: case _FX1E: case _FX29: case _FX65:
+    case _00FD: case _FX30: case _5XY3: case _F000:
+        return true;
+    default:
+        return false;
+    }
+}
+
 }
 
 
@@ -44,16 +136,33 @@ Chip8::Chip8()
     m_register.timer_delay = 0;
     m_register.timer_sound = 0;
     m_await_interrupt = false;
+    m_buzzer = false;
+    m_tick_carry = 0;
+    if constexpr(profiling) m_profile = std::make_unique<Profile>(memory_size);
+    m_idle_cycles = 0;
+    m_instruction_count = 0;
+    seed(0);
+    m_quirks = m_settings.quirks();
+    m_instructions.select(m_quirks);
     std::fill(m_register.V.begin(), m_register.V.end(), 0);
 
     /* initialize memory */
     std::fill(m_keypad.begin(), m_keypad.end(), 0);
-    std::fill(m_display.begin(), m_display.end(), false);
+    m_display.m_planes = {};
+    m_display.m_hires = false;
+    m_display.m_mask = 0x1;
+    m_display.changed(~uint64(0));
     std::fill(m_memory.begin(), m_memory.end(), 0);
     std::fill(m_stack.begin(), m_stack.end(), 0);
+    std::fill(m_flags.begin(), m_flags.end(), 0);
+    m_audio = Audio();
 
     /* load fonts into memory */
-    std::copy(detail::fontset.begin(), detail::fontset.end(), m_memory.begin());
+    std::copy(detail::fontset.begin(), detail::fontset.end(), m_memory.begin() + font_addr);
+    std::copy(detail::big_fontset.begin(), detail::big_fontset.end(), m_memory.begin() + big_font_addr);
+
+    /* fill instruction cache */
+    invalidate(0, memory_size);
 }
 
 bool Chip8::load_rom(const std::filesystem::path& path)
@@ -77,30 +186,424 @@ bool Chip8::load_rom(const std::vector<uint8>& code)
         return false;
     }
 
-    std::copy(code.begin(), code.end(), m_memory.begin() + 0x200);
+    std::copy(code.begin(), code.end(), m_memory.begin() + start_addr);
+    invalidate(start_addr, static_cast<uint32>(code.size()));
+
+    /* another translated program may match the new rom */
+    m_aot.reset();
     return true;
 }
 
 void Chip8::execute_cycle()
 {
-    /* fetch next opcode */
-    auto op_code = m_memory[m_register.PC] << 8 | m_memory[m_register.PC + 1];
+    select_quirks();
+    if(m_trace) step_traced(m_instruction_count);
+    else step();
+    m_instruction_count++;
+}
+
+void Chip8::step()
+{
+    /* the fetch wraps around the end of memory (BNNN can jump past it) */
+    const uint32 pc = m_register.PC & memory_mask;
+
+    /* odd program counter (rare): fetch and decode uncached */
+    if(pc & 0x1)
+    {
+        auto op_code = m_memory[pc] << 8 | m_memory[(pc + 1) & memory_mask];
+
+        if constexpr(profiling) m_profile->count(m_register.PC, m_instructions.predecode(op_code));
+
+        const auto& instruction = m_instructions.decode(op_code);
+        m_register.PC += instruction.m_exec(*this, op_code);
+        return;
+    }
+
+    /* fetch predecoded instruction and execute */
+    const auto decoded = m_decoded[pc >> 1];
+    if constexpr(profiling) m_profile->count(m_register.PC, decoded);
+    m_register.PC += decoded.m_exec(*this, decoded.m_op_code);
+}
+
+void Chip8::step_traced(uint64 cycle)
+{
+    /* the opcode is read first (the instruction may overwrite itself) */
+    const auto pc = m_register.PC;
+    const uint16 op_code = m_memory[pc % memory_size] << 8 | m_memory[(pc + 1) % memory_size];
+    const auto before = m_register.V;
+
+    step();
+    m_trace->record(cycle, pc, op_code, m_register.I, before, m_register.V);
+}
+
+int Chip8::execute_traced(int cycles)
+{
+    const uint64 first = m_instruction_count - cycles;
+    for(int i = 0; i < cycles; i++)
+    {
+        step_traced(first + i);
+        if(m_await_interrupt) return cycles - i - 1;
+    }
+
+    return 0;
+}
+
+void Chip8::invalidate(uint16 addr, uint32 size)
+{
+    /* indexed writes wrap around the end of memory: the wrapped part separately */
+    addr &= memory_mask;
+    if(addr + size > memory_size)
+    {
+        invalidate(0, addr + size - memory_size);
+        size = memory_size - addr;
+    }
+
+    /* a write to byte b only affects the entry at (b & ~1), since entries start at even addresses */
+    const uint32 end = std::min<uint32>(uint32(addr) + size, memory_size);
+    for(uint32 a = addr & ~0x1u; a < end; a += 2)
+    {
+        m_decoded[a >> 1] = m_instructions.predecode(m_memory[a] << 8 | m_memory[a + 1]);
+    }
+
+    if(m_jit) m_jit->invalidate(addr, size);
+    if(m_aot) m_aot->invalidate(*this, addr, size);
+}
+
+uint8 Chip8::draw_sprite(uint8 vx, uint8 vy, uint16 addr, uint8 height)
+{
+    /* one instantiation per resolution and sprite width (DXY0: 16x16), the chip-8 path stays as lean as before */
+    const auto draw = [this, vx, vy, height](Display::Plane& plane, uint16 from) -> uint8
+    {
+        if(height != 0)
+        {
+            return m_display.m_hires ? detail::draw<true, false>(m_display, plane, m_memory, vx, vy, from, height)
+                                     : detail::draw<false, false>(m_display, plane, m_memory, vx, vy, from, height);
+        }
+
+        return m_display.m_hires ? detail::draw<true, true>(m_display, plane, m_memory, vx, vy, from, 16)
+                                 : detail::draw<false, true>(m_display, plane, m_memory, vx, vy, from, 16);
+    };
+
+    const auto sprite = [&]() -> uint8
+    {
+        if constexpr(Display::plane_count == 1)
+        {
+            return draw(m_display.m_planes[0], addr);
+        }
+        else
+        {
+            /* XO-CHIP: the sprite of the next selected plane follows the previous one */
+            uint8 collision = 0;
+            m_display.selected([&](Display::Plane& plane)
+            {
+                collision |= draw(plane, addr);
+                addr += height != 0 ? height : 32;
+            });
+            return collision;
+        }
+    };
+
+    if constexpr(profiling)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto collision = sprite();
+        m_profile->m_draw_time += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return collision;
+    }
+    else
+    {
+        return sprite();
+    }
+}
+
+void Chip8::Display::resolution(bool hires)
+{
+    m_hires = hires;
+    m_planes = {};
+    changed(~uint64(0));
+}
+
+void Chip8::Display::scroll_down(int rows)
+{
+    const int h = height();
+    rows = std::min(rows, h);
+    if(rows == 0) return;
+
+    selected([this, h, rows](Plane& plane)
+    {
+        for(int c = 0; c < width() / 64; c++)
+        {
+            auto& column = plane[c];
+            std::copy_backward(column.begin(), column.begin() + h - rows, column.begin() + h);
+            std::fill(column.begin(), column.begin() + rows, 0);
+        }
+    });
+    changed(~uint64(0) >> (64 - h));
+}
+
+void Chip8::Display::scroll_up(int rows)
+{
+    const int h = height();
+    rows = std::min(rows, h);
+    if(rows == 0) return;
+
+    selected([this, h, rows](Plane& plane)
+    {
+        for(int c = 0; c < width() / 64; c++)
+        {
+            auto& column = plane[c];
+            std::copy(column.begin() + rows, column.begin() + h, column.begin());
+            std::fill(column.begin() + h - rows, column.begin() + h, 0);
+        }
+    });
+    changed(~uint64(0) >> (64 - h));
+}
+
+void Chip8::Display::scroll_left(int columns)
+{
+    const int h = height();
+    selected([this, h, columns](Plane& plane)
+    {
+        auto& left = plane[0];
+        auto& right = plane[1];
+
+        for(int y = 0; y < h; y++)
+        {
+            left[y] = m_hires ? left[y] << columns | right[y] >> (64 - columns) : left[y] << columns;
+            right[y] <<= columns;
+        }
+    });
+    changed(~uint64(0) >> (64 - h));
+}
+
+void Chip8::Display::scroll_right(int columns)
+{
+    const int h = height();
+    selected([this, h, columns](Plane& plane)
+    {
+        auto& left = plane[0];
+        auto& right = plane[1];
+
+        for(int y = 0; y < h; y++)
+        {
+            right[y] = m_hires ? right[y] >> columns | left[y] << (64 - columns) : 0;
+            left[y] >>= columns;
+        }
+    });
+    changed(~uint64(0) >> (64 - h));
+}
+
+void Chip8::select_quirks()
+{
+    if(m_settings.quirks() == m_quirks) return;
 
-    /* decode instruction and execute */
-    const auto& instruction = m_instructions.decode(op_code);
-    m_register.PC += instruction.m_exec(*this, op_code);
+    /* re-decode everything with the handlers of the new quirk set */
+    m_quirks = m_settings.quirks();
+    m_instructions.select(m_quirks);
+    invalidate(0, memory_size);
 }
 
 void Chip8::tick()
 {
-    for(int i = 0; i < m_settings.m_cycles; i++)
+    run(tick_cycles());
+    tick_timers();
+}
+
+void Chip8::run(int cycles)
+{
+    select_quirks();
+    m_instruction_count += std::max(cycles, 0);
+
+    /* FX0A without a pressed key changes nothing until the keypad does */
+    if(waiting())
+    {
+        m_idle_cycles += std::max(cycles, 0);
+        if constexpr(profiling) m_profile->m_waiting += std::max(cycles, 0);
+        return;
+    }
+
+    if(m_settings.m_idle_skip && !m_trace) cycles = skip_idle(cycles);
+
+    /* every core stops at a FX0A that starts waiting and returns the rest of the budget */
+    int left = 0;
+    switch(m_settings.m_core)
     {
-        execute_cycle();
+    case CORE_THREADED:
+        left = execute_threaded(cycles);
+        break;
+    case CORE_JIT:
+        /* blocks cannot be observed per instruction, a trace is recorded by the threaded core */
+        if(m_trace)
+        {
+            left = execute_threaded(cycles);
+            break;
+        }
+
+        if(!m_jit) m_jit = std::make_unique<Jit>(*this);
+        left = m_jit->execute(*this, cycles);
+        break;
+    case CORE_AOT:
+        if(m_trace)
+        {
+            left = execute_threaded(cycles);
+            break;
+        }
+
+        if(!m_aot) m_aot = std::make_unique<Aot>(*this);
+        left = m_aot->execute(*this, cycles);
+        break;
+    case CORE_TABLE:
+    default:
+        if(m_trace)
+        {
+            left = execute_traced(cycles);
+            break;
+        }
+
+        for(int i = 0; i < cycles; i++)
+        {
+            step();
+            if(m_await_interrupt)
+            {
+                left = cycles - i - 1;
+                break;
+            }
+        }
+        break;
     }
 
-    /* timer tick (currently expects that tick is called at 60Hz) */
-    if(m_register.timer_delay > 0) m_register.timer_delay--;;
+    m_idle_cycles += left;
+    if constexpr(profiling) m_profile->m_waiting += left;
+}
+
+bool Chip8::waiting() const
+{
+    return m_await_interrupt && std::none_of(m_keypad.begin(), m_keypad.end(), [](bool key) { return key; });
+}
+
+uint64 Chip8::fast_forward(uint64 ticks)
+{
+    if(!waiting()) return 0;
+
+    /* the ticks would only count down the timers (and carry the speed remainder) */
+    m_buzzer = ticks > 0 ? m_register.timer_sound >= ticks : m_buzzer;
+    m_register.timer_delay -= static_cast<uint8>(std::min<uint64>(m_register.timer_delay, ticks));
+    m_register.timer_sound -= static_cast<uint8>(std::min<uint64>(m_register.timer_sound, ticks));
+
+    uint64 cycles = ticks * std::max(m_settings.m_cycles, 0);
+    if(m_settings.m_speed > 0)
+    {
+        const uint64 total = m_tick_carry + ticks * uint64(m_settings.m_speed);
+        cycles = total / tick_rate;
+        m_tick_carry = static_cast<uint8>(total % tick_rate);
+    }
+
+    m_idle_cycles += cycles;
+    m_instruction_count += cycles;
+    if constexpr(profiling) m_profile->m_waiting += cycles;
+    return ticks;
+}
+
+int Chip8::skip_idle(int cycles)
+{
+    /* cheap static check first: a backward jump to at or before PC within the next pure instructions */
+    const auto pc = m_register.PC;
+    if((pc & 0x1) || pc >= memory_size) return cycles;
+
+    bool loop = false;
+    for(uint32 addr = pc; !loop && addr < memory_size && addr < pc + 2u * detail::idle_length; addr += 2)
+    {
+        const auto& decoded = m_decoded[addr >> 1];
+        if(!detail::pure(decoded.m_code)) return cycles;
+
+        /* 00FD (exit) spins on itself like a jump to itself */
+        loop = (decoded.m_code == detail::_1NNN && decoded.m_op_code.nnn() <= pc) || decoded.m_code == detail::_00FD;
+    }
+    if(!loop) return cycles;
+
+    /* run iterations (they count against the budget): once an iteration ends in the state it started with,
+     * all further iterations of this run are identical (timers and keypad only change between runs) */
+    for(int attempt = 0; attempt < 2; attempt++)
+    {
+        const auto start = m_register;
+        int length = 0;
+        std::array<uint16, detail::idle_length> path;    /* addresses of the iteration (profile) */
+        do
+        {
+            const auto at = m_register.PC;
+            if(cycles == 0 || length == detail::idle_length || (at & 0x1) || at >= memory_size ||
+               !detail::pure(m_decoded[at >> 1].m_code)) return cycles;
+
+            path[length] = at;
+
+            step();
+            cycles--;
+            length++;
+        }
+        while(m_register.PC != start.PC);
+
+        if(std::memcmp(&m_register, &start, sizeof(Registers)) == 0)
+        {
+            const int skipped = cycles - cycles % length;
+            m_idle_cycles += skipped;
+
+            /* the skipped iterations run the instructions of this one */
+            if constexpr(profiling)
+            {
+                for(int i = 0; i < length; i++) m_profile->count(path[i], m_decoded[path[i] >> 1], skipped / length);
+                m_profile->m_idle += skipped;
+            }
+
+            return cycles - skipped;
+        }
+    }
+
+    return cycles;
+}
+
+bool Chip8::buzzer() const
+{
+    return m_buzzer;
+}
+
+uint64 Chip8::idle_cycles() const
+{
+    return m_idle_cycles;
+}
+
+void Chip8::tick_timers()
+{
+    m_buzzer = m_register.timer_sound > 0;
+    if(m_register.timer_delay > 0) m_register.timer_delay--;
     if(m_register.timer_sound > 0) m_register.timer_sound--;
+
+    if(m_settings.m_speed > 0) m_tick_carry = static_cast<uint8>((m_tick_carry + m_settings.m_speed % tick_rate) % tick_rate);
+}
+
+int Chip8::tick_cycles() const
+{
+    if(m_settings.m_speed <= 0) return m_settings.m_cycles;
+
+    return static_cast<int>((int64(m_tick_carry) + m_settings.m_speed) / tick_rate);
+}
+
+uint64 Chip8::instructions() const
+{
+    return m_instruction_count;
+}
+
+void Chip8::seed(uint32 seed)
+{
+    /* xorshift state must not be zero */
+    m_random = seed ? seed : 0x2545F491;
+}
+
+uint32 Chip8::random()
+{
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
 }
 
 Chip8::Registers& Chip8::regs()
@@ -153,22 +656,61 @@ const Chip8::Settings& Chip8::settings() const
     return m_settings;
 }
 
+Chip8::Audio& Chip8::audio()
+{
+    return m_audio;
+}
+
+const Chip8::Audio& Chip8::audio() const
+{
+    return m_audio;
+}
+
+void Chip8::trace(std::unique_ptr<Trace> trace)
+{
+    m_trace = std::move(trace);
+}
+
+Trace* Chip8::trace()
+{
+    return m_trace.get();
+}
+
+const Trace* Chip8::trace() const
+{
+    return m_trace.get();
+}
+
+Profile* Chip8::profile()
+{
+    return m_profile.get();
+}
+
+const Profile* Chip8::profile() const
+{
+    return m_profile.get();
+}
+
 std::ostream& operator<<(std::ostream& stream, const Chip8& emu)
 {
     auto& display = emu.display();
     auto& regs = emu.regs();
 
-    stream << "+----------------------------------------------------------------+\n";
-    for(int y = 0; y < emu::Chip8::height_res; y++)
+    /* active resolution (hires is twice as wide as the register box) */
+    std::string border(display.width() + 2, '-');
+    border.front() = border.back() = '+';
+
+    stream << border << "\n";
+    for(int y = 0; y < display.height(); y++)
     {
         stream << "|";
-        for(int x = 0; x < emu::Chip8::width_res; x++)
+        for(int x = 0; x < display.width(); x++)
         {
-            stream << (display[x + y*Chip8::width_res] ? "#" : " ");
+            stream << (display.pixel(x, y) ? "#" : " ");
         }
         stream << "|\n";
     }
-    stream << "+----------------------------------------------------------------+\n";
+    stream << border << "\n";
 
     stream << "\n+---------------------------[Register]---------------------------+\n";
     stream << " [V0]: " << std::setfill('0') << std::setw(2) << std::hex << (int)regs.V[0x0];
@@ -1,16 +1,27 @@
 #pragma once
 
+#include "aot.h"
 #include "base.h"
 #include "instruction.h"
+#include "jit.h"
+#include "profile.h"
+#include "trace.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <filesystem>
+#include <memory>
 #include <ostream>
 #include <vector>
 
 namespace emu
 {
 
+template<std::size_t N>
+struct Chip8Batch;
+struct Rewind;
+
 /*
  *  Chip8 Interpreter
  *  -----------------------------
@@ -22,6 +33,8 @@ namespace emu
  *  Memory Map: (from http://devernay.free.fr/hacks/chip8/C8TECH10.HTM):
  *  -----------------------------
  *
+ *  +---------------+= 0xFFFF (65535) End of XO-CHIP RAM (CHIP8_XOCHIP builds)
+ *  |               |
  *  +---------------+= 0xFFF (4095) End of Chip-8 RAM
  *  |               |
  *  |               |
@@ -43,7 +56,9 @@ namespace emu
  *  | 0x000 to 0x1FF|
  *  | Reserved for  |
  *  |  interpreter  |
- *  +---------------+= 0x000 (0) Start of Chip-8 RAM
+ *  +- - - - - - - -+= 0x050 (80) SUPER-CHIP 8x10 font
+ *  |               |
+ *  +---------------+= 0x000 (0) Chip-8 4x5 font
  *
  *
  *  Registers:
@@ -76,10 +91,23 @@ namespace emu
  *  | (0, 31)               (63, 31) |
  *  +--------------------------------+
  *  Chip-8 uses sprites to draw graphics on the screen; which have a size up to 15 bytes, resulting in a potential size of 8x15 pixels.
+ *  Sprites wrap around as a whole (start coordinate modulo resolution) but are clipped at the right and bottom edge.
+ *  The display is stored bit-packed (one 64-bit word per row and 64 columns), drawing a sprite row is one shift, xor and and-test.
  *  The program can also utilize a set of sprites representing the hexadecimal digits 0 to F.
  *  These sprites consist of 5 bytes each and have dimensions of 8x5 pixels.
  *  Is stored in memory from 0x000 to 0x1FF.
  *
+ *  SUPER-CHIP 128x64 display (00FF, 00FE switches back; switching clears the display):
+ *    -> DXY0 draws a 16x16 sprite (two bytes per row) in both resolutions, VF is 1 on any collision
+ *    -> 00CN, 00FB and 00FC scroll by N rows and 4 columns of the active resolution
+ *       (rows are moved as a whole, columns are shifted across the two words of a row)
+ *    -> FX30 points I at an 8x10 digit (0 to F) of the big font
+ *
+ *  XO-CHIP (CHIP8_XOCHIP builds) adds a second plane, a pixel has one of four colors (plane 0 | plane 1 << 1):
+ *    -> FN01 selects the planes 00E0, DXYN and the scrolls work on (bitmask N, default plane 0)
+ *    -> DXYN draws into each selected plane in order, the sprite data of the next plane follows the previous one
+ *    -> 00DN scrolls up by N rows
+ *
  *
  *
  *  Instructions:
@@ -87,6 +115,10 @@ namespace emu
  *    - 35 different instructions (math, graphics, control)
  *    - instructions are 2 bytes long and are stored most-significant-byte first
  *    - reference https://github.com/mattmikolay/chip-8/wiki/CHIP%E2%80%908-Instruction-Set
+ *    - SUPER-CHIP 1.1: 00CN, 00FB, 00FC, 00FD, 00FE, 00FF, DXY0, FX30, FX75, FX85
+ *      (00FD stops the program: PC stays on it, the idle loop skip consumes the rest of every tick)
+ *    - XO-CHIP (CHIP8_XOCHIP builds): 00DN, 5XY2, 5XY3, F000 NNNN, FN01, F002, FX3A
+ *      (F000 NNNN is 4 bytes long, skips jump over it as a whole)
  *
  *  -----------------------------
  *  @author Nikolaus Rauch
@@ -101,16 +133,135 @@ struct Chip8
         COUNT
     };
 
+    /* execution cores (selectable at runtime via Settings::m_core) */
+    enum eCore
+    {
+        CORE_TABLE = 0,     /* function table dispatch per instruction (reference) */
+        CORE_THREADED,      /* threaded code (computed goto) running a whole tick budget */
+        CORE_JIT,           /* x86-64 basic block recompiler (falls back to the table on other hosts) */
+        CORE_AOT            /* blocks of a linked chip-8-aot translation of the rom (falls back to the threaded core) */
+    };
+
+    /* emulation quirks (bitmask selects the specialized handlers at runtime) */
+    enum eQuirk : uint8
+    {
+        QUIRK_VF_RESET = 1 << 0,
+        QUIRK_MEMORY   = 1 << 1,
+        QUIRK_SHIFTING = 1 << 2,
+        QUIRK_JUMPING  = 1 << 3
+    };
+    static constexpr uint8 quirk_count = 16;
+
+    /* XO-CHIP is selected at compile time (CHIP8_XOCHIP): the chip-8 build keeps its 4 KB memory and single plane,
+     * the XO-CHIP instructions decode as unknown there */
+#ifdef CHIP8_XOCHIP
+    static constexpr bool xo_chip = true;
+#else
+    static constexpr bool xo_chip = false;
+#endif
+
+    /* execution profiling is selected at compile time (CHIP8_PROFILE): counters and hooks are compiled out without it */
+#ifdef CHIP8_PROFILE
+    static constexpr bool profiling = true;
+#else
+    static constexpr bool profiling = false;
+#endif
+
     /* memory pointer */
-    static constexpr uint16 font_addr = 0x50;
+    static constexpr uint16 font_addr = 0x00;
+    static constexpr uint16 big_font_addr = 0x50;
     static constexpr uint16 start_addr = 0x200;
-    static constexpr uint16 end_addr = 0xE8F;
+    static constexpr uint32 end_addr = xo_chip ? 0x10000 : 0xE8F;
+    static constexpr uint32 memory_size = xo_chip ? 0x10000 : 0x1000;
+    static constexpr uint32 memory_mask = memory_size - 1;     /* indexed accesses (I + i) wrap around memory */
+
+    /* display resolution (width_res x height_res, or max_width_res x max_height_res in SUPER-CHIP hires mode) */
     static constexpr uint16 width_res = 64;
     static constexpr uint16 height_res = 32;
-    static constexpr uint16 memory_size = 0x1000;
+    static constexpr uint16 max_width_res = 128;
+    static constexpr uint16 max_height_res = 64;
+
+    /* save state format version (bumped on every layout change) */
+    static constexpr uint16 state_version = 4;
+
+    /* rate of the delay and sound timer (one tick) */
+    static constexpr int tick_rate = 60;
 
     /* Hardware Components */
-    using Display = std::array<bool, width_res * height_res>;
+
+    /* packed display planes: m_planes[p][x / 64][y] holds 64 pixels of row y, the most significant bit is the leftmost pixel;
+     * lores mode only uses the first height_res words of column 0 (the exact chip-8 layout, the rest stays zero) */
+    struct Display
+    {
+        using Word = uint64;
+        using Column = std::array<Word, max_height_res>;
+        using Plane = std::array<Column, max_width_res / 64>;
+        static_assert(sizeof(Word) * 8 == width_res);
+        static_assert(max_height_res <= 64);
+
+        static constexpr int plane_count = xo_chip ? 2 : 1;
+
+        std::array<Plane, plane_count> m_planes;
+        bool m_hires = false;
+        uint8 m_mask = 0x1;         /* planes selected by FN01 (bit p: plane p) */
+
+        /* change tracking for front ends (drawing, scrolling, clearing and restoring a snapshot set it, only the front end resets m_dirty) */
+        uint64 m_dirty = 0;         /* bit y: row y (of the active resolution) changed since the front end last reset it */
+        uint64 m_generation = 0;    /* incremented whenever rows change */
+
+        /* active resolution */
+        uint16 width() const { return m_hires ? max_width_res : width_res; }
+        uint16 height() const { return m_hires ? max_height_res : height_res; }
+
+        /* pixel access by index (x + y * width()) or by coordinate (set in any plane), color: bit p from plane p */
+        bool operator[](std::size_t index) const { return pixel(index % width(), index / width()); }
+        bool pixel(uint16 x, uint16 y) const { return color(x, y) != 0; }
+        uint8 color(uint16 x, uint16 y) const
+        {
+            uint8 value = 0;
+            for(int p = 0; p < plane_count; p++) value |= ((m_planes[p][x / 64][y] >> (63 - x % 64)) & 0x1) << p;
+            return value;
+        }
+
+        /* calls func(plane) for each selected plane (always plane 0 in the chip-8 build) */
+        template<typename Func>
+        void selected(Func&& func)
+        {
+            if constexpr(plane_count == 1) func(m_planes[0]);
+            else for(int p = 0; p < plane_count; p++) if((m_mask >> p) & 0x1) func(m_planes[p]);
+        }
+
+        /* clears the selected planes (words outside the active resolution are always zero) */
+        void clear()
+        {
+            uint64 rows = 0;
+            selected([this, &rows](Plane& plane)
+            {
+                for(int c = 0; c < width() / 64; c++)
+                {
+                    auto& column = plane[c];
+                    for(int y = 0; y < height(); y++) rows |= uint64(column[y] != 0) << y;
+                    std::fill(column.begin(), column.begin() + height(), 0);
+                }
+            });
+            changed(rows);
+        }
+
+        void changed(uint64 rows)
+        {
+            m_dirty |= rows;
+            m_generation += rows != 0;
+        }
+
+        /* SUPER-CHIP: switch resolution (clears all planes), scroll the selected planes down by rows / left and right by columns;
+         * XO-CHIP: scroll up by rows */
+        void resolution(bool hires);
+        void scroll_down(int rows);
+        void scroll_up(int rows);
+        void scroll_left(int columns);
+        void scroll_right(int columns);
+    };
+
     using Keypad = std::array<bool, eKey::COUNT>;
     using Memory = std::array<uint8, memory_size>;
 
@@ -125,6 +276,17 @@ struct Chip8
         uint8 timer_sound;
     };
 
+    /* XO-CHIP audio: while the sound timer runs, the 128 1-bit samples of the pattern (F002, MSB first) loop at
+     * 4000 * 2^((pitch - 64) / 48) samples per second (FX3A); until a pattern is loaded a plain tone is played */
+    struct Audio
+    {
+        std::array<uint8, 16> m_pattern{};
+        uint8 m_pitch = 64;
+        bool m_loaded = false;
+
+        double rate() const { return 4000.0 * std::exp2((m_pitch - 64) / 48.0); }
+    };
+
     struct Settings
     {
         bool m_vf_reset = false;
@@ -132,7 +294,24 @@ struct Chip8
         bool m_shifting = false;
         bool m_jumping = false;
 
+        /* instructions per tick (used while m_speed is 0) */
         int m_cycles = 20;
+
+        /* instructions per second: a tick runs m_speed / tick_rate instructions, the remainder is carried to the next
+         * tick (exact rate independent of the timers, e.g. 500 hz runs 8, 8, 9, 8, 8, 9, ...; not used by Chip8Batch) */
+        int m_speed = 0;
+
+        eCore m_core = CORE_TABLE;
+
+        /* skip the rest of a tick spent in an idle loop (e.g. FX07, 3X00, 1NNN polling the delay timer) */
+        bool m_idle_skip = true;
+
+        /* quirk flags as eQuirk bitmask */
+        uint8 quirks() const
+        {
+            return (m_vf_reset ? QUIRK_VF_RESET : 0) | (m_memory ? QUIRK_MEMORY : 0) |
+                   (m_shifting ? QUIRK_SHIFTING : 0) | (m_jumping ? QUIRK_JUMPING : 0);
+        }
     };
 
 
@@ -145,12 +324,54 @@ public:
     /* load rom from memory */
     bool load_rom(const std::vector<uint8>& code);
 
-    /* executes a single instruction */
+    /* executes a single instruction (picks up changed quirk settings) */
     void execute_cycle();
 
-    /* should be called at 60hz (runs a hardcoded number of instructions -> m_cycles) */
+    /* re-decode cached instructions overlapping [addr, addr + size) (call after writing to memory() directly) */
+    void invalidate(uint16 addr, uint32 size);
+
+    /* should be called at 60hz (runs the instructions of one tick -> tick_cycles(); picks up changed quirk settings) */
     void tick();
 
+    /* the two halves of tick: run a number of instructions with the selected core, decrement the timers
+     * (tick() == run(tick_cycles()) + tick_timers(); run(a) + run(b) == run(a + b) for every core) */
+    void run(int cycles);
+    void tick_timers();
+
+    /* instructions of the next tick (m_cycles, or m_speed / tick_rate plus the remainder carried by tick_timers) */
+    int tick_cycles() const;
+
+    /* instructions run since construction (including skipped idle and waiting ones) */
+    uint64 instructions() const;
+
+    /* FX0A is waiting for a key and none is pressed: run() returns immediately, a tick only counts down the timers */
+    bool waiting() const;
+
+    /* skip up to ticks while waiting (front ends jump to their next input event; the result equals ticking);
+     * returns the ticks skipped (0 if not waiting) */
+    uint64 fast_forward(uint64 ticks);
+
+    /* the sound timer was running during the last tick (set by tick_timers and fast_forward; front ends sound the
+     * buzzer for the whole tick; output like Display::m_dirty, not part of the saved state) */
+    bool buzzer() const;
+
+    /* instructions skipped by idle loop detection or while waiting for a key (counted as executed) */
+    uint64 idle_cycles() const;
+
+    /* seed the random number generator of CXNN (state is per instance, the default seed is fixed) */
+    void seed(uint32 seed);
+
+    /* snapshot of the complete state (registers, stack, display, keypad, memory, settings; format in state.cpp)
+     * the buffer overload reuses its capacity, so saving every frame does not allocate */
+    void save_state(std::vector<uint8>& state) const;
+    std::vector<uint8> save_state() const;
+    bool save_state(const std::filesystem::path& path) const;
+
+    /* restore a snapshot (rejects invalid data without changing the state; files are memory mapped) */
+    bool load_state(const uint8* data, std::size_t size);
+    bool load_state(const std::vector<uint8>& state);
+    bool load_state(const std::filesystem::path& path);
+
     /* access internal data */
     Registers& regs();
     const Registers& regs() const;
@@ -162,7 +383,58 @@ public:
     const Memory& memory() const;
     Settings& settings();
     const Settings& settings() const;
+    Audio& audio();
+    const Audio& audio() const;
+
+    /* record every executed instruction into trace (nullptr stops; while tracing, the JIT and AOT cores run the
+     * threaded one and idle loops are executed instead of skipped, the results stay identical) */
+    void trace(std::unique_ptr<Trace> trace);
+    Trace* trace();
+    const Trace* trace() const;
+
+    /* execution profile since construction or the last Profile::clear() (nullptr without CHIP8_PROFILE) */
+    Profile* profile();
+    const Profile* profile() const;
+
+
+private:
+    /* executes a single instruction with the selected handlers */
+    void step();
+
+    /* step() and a trace record (cycle: instructions before this one) */
+    void step_traced(uint64 cycle);
+
+    /* table core while tracing (called by run(), idle loops are not skipped); returns the instructions left when
+     * FX0A starts waiting */
+    int execute_traced(int cycles);
+
+    /* switch handlers and caches to the quirks in m_settings (only if they changed) */
+    void select_quirks();
+
+    /* detect an idle loop at PC and consume the cycles it would spin for; returns the cycles left to execute
+     * (a loop of pure instructions whose iteration leaves the registers unchanged) */
+    int skip_idle(int cycles);
+
+    /* draws sprite (height rows from addr; 0: 16x16) at (vx, vy) into the selected planes and returns 1 on collision
+     * (shared by all cores) */
+    uint8 draw_sprite(uint8 vx, uint8 vy, uint16 addr, uint8 height);
+
+    /* bytes a taken skip (3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1) at pc jumps over (XO-CHIP: F000 NNNN is 4 bytes long) */
+    uint16 skip_size(uint16 pc) const
+    {
+        if constexpr(xo_chip) return m_memory[uint16(pc + 2)] == 0xF0 && m_memory[uint16(pc + 3)] == 0x00 ? 4 : 2;
+        else return 2;
+    }
+
+    /* next value of the per instance random number generator (xorshift32) */
+    uint32 random();
 
+    /* threaded code core: runs a budget of instructions with registers held in locals (threaded.cpp; records every
+     * instruction while tracing); returns the instructions left when FX0A starts waiting */
+    int execute_threaded(int cycles);
+
+    template<uint8 Quirks, bool Traced>
+    int run_threaded(int cycles);
 
 private:
     Settings m_settings;
@@ -171,11 +443,41 @@ private:
     Keypad m_keypad;
     Memory m_memory;
     std::array<uint16, 16> m_stack;
+    std::array<uint8, 16> m_flags;  /* SUPER-CHIP user flags (FX75, FX85) */
+    Audio m_audio;
     bool m_await_interrupt;
+    bool m_buzzer;
+    uint8 m_quirks;
+    uint32 m_random;
+    uint8 m_tick_carry;             /* m_speed remainder carried to the next tick (< tick_rate) */
+    uint64 m_idle_cycles;
+    uint64 m_instruction_count;
 
     Instruction m_instructions;
 
+    /* predecoded instruction per even address (kept coherent with m_memory by invalidate) */
+    std::array<Instruction::Decoded, memory_size / 2> m_decoded;
+
+    /* execution trace (while recording) */
+    std::unique_ptr<Trace> m_trace;
+
+    /* counters of CHIP8_PROFILE builds */
+    std::unique_ptr<Profile> m_profile;
+
+    /* translated blocks (created on first use of CORE_JIT) */
+    std::unique_ptr<Jit> m_jit;
+
+    /* blocks of the matching translated program (created on first use of CORE_AOT, dropped by load_rom) */
+    std::unique_ptr<Aot> m_aot;
+
     friend struct Instruction;
+    friend struct Jit;
+    friend struct Aot;
+
+    template<std::size_t N>
+    friend struct Chip8Batch;
+
+    friend struct Rewind;
 };
 
 std::ostream& operator<< (std::ostream& stream, const emu::Chip8& emu);
@@ -0,0 +1,44 @@
+#include "hash.h"
+
+namespace emu
+{
+
+uint64 fnv1a(const uint8* data, std::size_t size, uint64 hash)
+{
+    for(std::size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= fnv_prime;
+    }
+
+    return hash;
+}
+
+uint64 hash(const Chip8::Display& display)
+{
+    uint64 hash = fnv_offset;
+    for(const auto& plane : display.m_planes)
+    {
+        for(int y = 0; y < display.height(); y++)
+        {
+            for(int c = 0; c < display.width() / 64; c++)
+            {
+                const auto word = plane[c][y];
+                for(int i = 0; i < 8; i++)
+                {
+                    hash ^= (word >> (i * 8)) & 0xFF;
+                    hash *= fnv_prime;
+                }
+            }
+        }
+    }
+
+    return hash;
+}
+
+uint64 hash(const Chip8::Memory& memory)
+{
+    return fnv1a(memory.data(), memory.size());
+}
+
+}
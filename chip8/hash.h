@@ -0,0 +1,30 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <cstddef>
+
+namespace emu
+{
+
+/*
+ *  Chip8 State Hashes:
+ *  -----------------------------
+ *    -> FNV-1a (64-bit) over emulator state, to compare runs cheaply
+ *       (chip-8-headless --dump, chip-8-bench results, the rom check of input logs)
+ *    -> the display hash covers the packed rows of the active resolution (plane after plane, each word
+ *       least-significant byte first)
+ *
+ *  -----------------------------
+ */
+constexpr uint64 fnv_offset = 0xcbf29ce484222325;
+constexpr uint64 fnv_prime = 0x100000001b3;
+
+/* continue hash over size bytes */
+uint64 fnv1a(const uint8* data, std::size_t size, uint64 hash = fnv_offset);
+
+uint64 hash(const Chip8::Display& display);
+
+uint64 hash(const Chip8::Memory& memory);
+
+}
@@ -0,0 +1,296 @@
+#include "input_log.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace emu
+{
+
+namespace detail
+{
+
+constexpr uint8 input_log_magic[4] = { 'C', '8', 'I', 'N' };
+
+void put_fixed(std::vector<uint8>& out, uint64 v, int bytes)
+{
+    for(int i = 0; i < bytes; i++) out.push_back(v >> (8 * i));
+}
+
+void put_varint(std::vector<uint8>& out, uint64 v)
+{
+    for(; v >= 0x80; v >>= 7) out.push_back(0x80 | (v & 0x7F));
+    out.push_back(v);
+}
+
+/* bounds checked reader (sets m_valid = false on overrun) */
+struct Reader
+{
+    const uint8* m_in;
+    const uint8* m_end;
+    bool m_valid = true;
+
+    uint64 fixed(int bytes)
+    {
+        if(m_end - m_in < bytes) { m_valid = false; return 0; }
+
+        uint64 v = 0;
+        for(int i = 0; i < bytes; i++) v |= uint64(*m_in++) << (8 * i);
+        return v;
+    }
+
+    uint64 varint()
+    {
+        uint64 v = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+            if(m_in == m_end) break;
+
+            const uint8 byte = *m_in++;
+            v |= uint64(byte & 0x7F) << shift;
+            if(!(byte & 0x80)) return v;
+        }
+
+        m_valid = false;
+        return 0;
+    }
+};
+
+}
+
+void InputLog::begin(const Chip8& chip8, uint32 seed)
+{
+    m_seed = seed;
+    m_quirks = chip8.settings().quirks();
+    m_cycles = chip8.settings().m_cycles;
+    m_speed = chip8.settings().m_speed;
+    m_hash = hash(chip8.memory());
+    m_events.clear();
+    m_last = Event{ 0, 0, 0, false, m_quirks, m_cycles, m_speed };
+}
+
+void InputLog::record(uint64 tick, uint32 cycle, const Chip8& chip8)
+{
+    const auto& settings = chip8.settings();
+
+    Event event{ tick, cycle, keys(chip8.keypad()) };
+    event.m_settings = settings.quirks() != m_last.m_quirks || settings.m_cycles != m_last.m_cycles ||
+                       settings.m_speed != m_last.m_speed;
+    event.m_quirks = settings.quirks();
+    event.m_cycles = settings.m_cycles;
+    event.m_speed = settings.m_speed;
+
+    if(event.m_keys == m_last.m_keys && !event.m_settings) return;
+
+    m_events.push_back(event);
+    m_last = event;
+}
+
+void InputLog::truncate(uint64 tick)
+{
+    auto it = std::find_if(m_events.begin(), m_events.end(), [tick](const Event& event) { return event.m_tick >= tick; });
+    m_events.erase(it, m_events.end());
+
+    /* state after the remaining events */
+    m_last = Event{ 0, 0, 0, false, m_quirks, m_cycles, m_speed };
+    for(const auto& event : m_events)
+    {
+        m_last.m_keys = event.m_keys;
+        if(event.m_settings)
+        {
+            m_last.m_quirks = event.m_quirks;
+            m_last.m_cycles = event.m_cycles;
+            m_last.m_speed = event.m_speed;
+        }
+    }
+}
+
+bool InputLog::prepare(Chip8& chip8) const
+{
+    auto& settings = chip8.settings();
+    settings.m_vf_reset = m_quirks & Chip8::QUIRK_VF_RESET;
+    settings.m_memory = m_quirks & Chip8::QUIRK_MEMORY;
+    settings.m_shifting = m_quirks & Chip8::QUIRK_SHIFTING;
+    settings.m_jumping = m_quirks & Chip8::QUIRK_JUMPING;
+    settings.m_cycles = m_cycles;
+    settings.m_speed = m_speed;
+    chip8.seed(m_seed);
+    chip8.keypad().fill(false);
+
+    if(hash(chip8.memory()) != m_hash)
+    {
+        std::cerr << "[InputLog::prepare] Log was recorded with a different rom!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void InputLog::tick(uint64 tick, Chip8& chip8, std::size_t& cursor) const
+{
+    auto& settings = chip8.settings();
+
+    int done = 0;
+    for(; cursor < m_events.size() && m_events[cursor].m_tick <= tick; cursor++)
+    {
+        const auto& event = m_events[cursor];
+
+        /* run up to the cycle of the change (events of skipped ticks apply at cycle 0) */
+        const int at = event.m_tick < tick ? 0 : std::min<int>(event.m_cycle, chip8.tick_cycles());
+        if(at > done)
+        {
+            chip8.run(at - done);
+            done = at;
+        }
+
+        for(int k = 0; k < Chip8::COUNT; k++) chip8.keypad()[k] = (event.m_keys >> k) & 0x1;
+
+        if(event.m_settings)
+        {
+            settings.m_vf_reset = event.m_quirks & Chip8::QUIRK_VF_RESET;
+            settings.m_memory = event.m_quirks & Chip8::QUIRK_MEMORY;
+            settings.m_shifting = event.m_quirks & Chip8::QUIRK_SHIFTING;
+            settings.m_jumping = event.m_quirks & Chip8::QUIRK_JUMPING;
+            settings.m_cycles = event.m_cycles;
+            settings.m_speed = event.m_speed;
+        }
+    }
+
+    chip8.run(std::max(chip8.tick_cycles() - done, 0));
+    chip8.tick_timers();
+}
+
+uint64 InputLog::next(std::size_t cursor) const
+{
+    return cursor < m_events.size() ? m_events[cursor].m_tick : ~uint64(0);
+}
+
+bool InputLog::save(const std::filesystem::path& path) const
+{
+    std::vector<uint8> data(std::begin(detail::input_log_magic), std::end(detail::input_log_magic));
+    detail::put_fixed(data, version, 2);
+    detail::put_fixed(data, m_seed, 4);
+    detail::put_fixed(data, m_quirks, 1);
+    detail::put_fixed(data, static_cast<uint32>(m_cycles), 4);
+    detail::put_fixed(data, static_cast<uint32>(m_speed), 4);
+    detail::put_fixed(data, m_hash, 8);
+    detail::put_fixed(data, m_events.size(), 4);
+
+    uint64 tick = 0;
+    for(const auto& event : m_events)
+    {
+        detail::put_varint(data, event.m_tick - tick);
+        detail::put_varint(data, uint64(event.m_cycle) << 1 | event.m_settings);
+        detail::put_fixed(data, event.m_keys, 2);
+        if(event.m_settings)
+        {
+            detail::put_fixed(data, event.m_quirks, 1);
+            detail::put_varint(data, static_cast<uint32>(event.m_cycles));
+            detail::put_varint(data, static_cast<uint32>(event.m_speed));
+        }
+
+        tick = event.m_tick;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if(!file)
+    {
+        std::cerr << "[InputLog::save] Couldn't write " + path.string() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool InputLog::load(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "[InputLog::load] Log " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    const std::vector<uint8> data(std::istreambuf_iterator<char>(file), {});
+    detail::Reader reader{ data.data(), data.data() + data.size() };
+
+    if(data.size() < 4 || !std::equal(std::begin(detail::input_log_magic), std::end(detail::input_log_magic), data.begin()))
+    {
+        std::cerr << "[InputLog::load] Not a chip-8 input log: " + path.string() << std::endl;
+        return false;
+    }
+    reader.m_in += 4;
+
+    if(reader.fixed(2) != version)
+    {
+        std::cerr << "[InputLog::load] Unsupported input log version: " + path.string() << std::endl;
+        return false;
+    }
+
+    const auto seed = static_cast<uint32>(reader.fixed(4));
+    const auto quirks = static_cast<uint8>(reader.fixed(1));
+    const auto cycles = static_cast<int>(reader.fixed(4));
+    const auto speed = static_cast<int>(reader.fixed(4));
+    const auto memory_hash = reader.fixed(8);
+    const auto count = reader.fixed(4);
+
+    std::vector<Event> events;
+    uint64 tick = 0;
+    for(uint64 i = 0; i < count && reader.m_valid; i++)
+    {
+        Event event;
+        tick += reader.varint();
+        const auto cycle = reader.varint();
+
+        event.m_tick = tick;
+        event.m_cycle = static_cast<uint32>(cycle >> 1);
+        event.m_keys = static_cast<uint16>(reader.fixed(2));
+        event.m_settings = cycle & 0x1;
+        if(event.m_settings)
+        {
+            event.m_quirks = static_cast<uint8>(reader.fixed(1));
+            event.m_cycles = static_cast<int>(reader.varint());
+            event.m_speed = static_cast<int>(reader.varint());
+        }
+
+        events.push_back(event);
+    }
+
+    if(!reader.m_valid)
+    {
+        std::cerr << "[InputLog::load] Truncated input log: " + path.string() << std::endl;
+        return false;
+    }
+
+    m_seed = seed;
+    m_quirks = quirks;
+    m_cycles = cycles;
+    m_speed = speed;
+    m_hash = memory_hash;
+    m_events = std::move(events);
+    truncate(~uint64(0));
+    return true;
+}
+
+const std::vector<InputLog::Event>& InputLog::events() const
+{
+    return m_events;
+}
+
+uint32 InputLog::seed() const
+{
+    return m_seed;
+}
+
+uint16 InputLog::keys(const Chip8::Keypad& keypad)
+{
+    uint16 keys = 0;
+    for(int k = 0; k < Chip8::COUNT; k++) keys |= keypad[k] << k;
+    return keys;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Input Log:
+ *  -----------------------------
+ *    -> records keypad (and settings) changes with the tick and the cycle within the tick they were applied at
+ *    -> together with the random seed and the settings stored in the header, a replay is bit-exact
+ *       (all cores produce identical results, the core itself is not part of the log)
+ *    -> the hash of the memory at tick 0 identifies the rom (replay warns on a mismatch)
+ *
+ *  File format (little-endian):
+ *  -----------------------------
+ *    header: magic "C8IN", version (16-bit), seed (32-bit), quirks (8-bit), cycles per tick (32-bit),
+ *            speed (32-bit), memory hash (64-bit), event count (32-bit)
+ *    event:  tick delta to the previous event (varint), cycle << 1 | settings flag (varint),
+ *            keypad bits after the change (16-bit), [quirks (8-bit), cycles per tick (varint), speed (varint)]
+ *
+ *    Typical keypad events take 4 bytes.
+ *  -----------------------------
+ */
+struct InputLog
+{
+    static constexpr uint16 version = 2;
+
+    struct Event
+    {
+        uint64 m_tick;
+        uint32 m_cycle;             /* instructions of the tick executed before the change */
+        uint16 m_keys;              /* bit k = key k pressed */
+
+        bool m_settings = false;    /* quirks, cycles or speed changed */
+        uint8 m_quirks = 0;
+        int m_cycles = 0;
+        int m_speed = 0;
+    };
+
+public:
+    /* start a recording for chip8 in its initial state (stores seed, settings and memory hash; clears events) */
+    void begin(const Chip8& chip8, uint32 seed);
+
+    /* log keypad and settings if they changed since the last event (ticks and cycles in increasing order) */
+    void record(uint64 tick, uint32 cycle, const Chip8& chip8);
+
+    /* drop all events at or after tick (after rewinding a recording) */
+    void truncate(uint64 tick);
+
+    /* prepare chip8 for a replay (seed and settings from the header); false if the memory hash differs */
+    bool prepare(Chip8& chip8) const;
+
+    /* replay one tick: runs the cycles of the tick with the logged changes applied in between,
+     * then the timers; cursor is the index of the next event (start with 0) */
+    void tick(uint64 tick, Chip8& chip8, std::size_t& cursor) const;
+
+    /* tick of the next event to replay (~0 if there is none) */
+    uint64 next(std::size_t cursor) const;
+
+    bool save(const std::filesystem::path& path) const;
+    bool load(const std::filesystem::path& path);
+
+    const std::vector<Event>& events() const;
+    uint32 seed() const;
+
+private:
+    static uint16 keys(const Chip8::Keypad& keypad);
+
+private:
+    uint32 m_seed = 0;
+    uint8 m_quirks = 0;
+    int m_cycles = 0;
+    int m_speed = 0;
+    uint64 m_hash = 0;
+
+    std::vector<Event> m_events;
+    Event m_last{ 0, 0, 0 };    /* keypad and settings after the last event (recording) */
+};
+
+}
@@ -2,7 +2,7 @@
 
 #include "chip8.h"
 
-#include <cstring>
+#include <utility>
 
 namespace emu
 {
@@ -10,18 +10,6 @@ namespace emu
 namespace detail
 {
 
-enum eCode : int
-{
-    _00E0 = 0, _00EE,
-    _1NNN,_2NNN, _3XNN, _4XNN, _5XY0, _6XNN, _7XNN,
-    _8XY0, _8XY1, _8XY2, _8XY3, _8XY4, _8XY5, _8XY6, _8XY7, _8XYE,
-    _9XY0,
-    _ANNN, _BNNN, _CXNN, _DXYN,
-    _EX9E, _EXA1,
-    _FX07, _FX0A, _FX15, _FX18, _FX1E, _FX29, _FX33, _FX55, _FX65,
-    UNKOWN
-};
-
 /* Decode from OP Code to instruction table index */
 eCode mapping(const Instruction::OpCode op_code)
 {
@@ -29,17 +17,30 @@ eCode mapping(const Instruction::OpCode op_code)
     {
 
     case 0x0:
+        if(op_code.x() == 0x0 && op_code.y() == 0xC) return eCode::_00CN;
+        if(op_code.x() == 0x0 && op_code.y() == 0xD && Chip8::xo_chip) return eCode::_00DN;
         switch(op_code.nn())
         {
         case 0xE0: return eCode::_00E0;
         case 0xEE: return eCode::_00EE;
+        case 0xFB: return eCode::_00FB;
+        case 0xFC: return eCode::_00FC;
+        case 0xFD: return eCode::_00FD;
+        case 0xFE: return eCode::_00FE;
+        case 0xFF: return eCode::_00FF;
         default: return eCode::UNKOWN;
         }
     case 0x1: return eCode::_1NNN;
     case 0x2: return eCode::_2NNN;
     case 0x3: return eCode::_3XNN;
     case 0x4: return eCode::_4XNN;
-    case 0x5: return eCode::_5XY0;
+    case 0x5:
+        if constexpr(Chip8::xo_chip)
+        {
+            if(op_code.n() == 0x2) return eCode::_5XY2;
+            if(op_code.n() == 0x3) return eCode::_5XY3;
+        }
+        return eCode::_5XY0;
     case 0x6: return eCode::_6XNN;
     case 0x7: return eCode::_7XNN;
     case 0x8:
@@ -80,6 +81,13 @@ eCode mapping(const Instruction::OpCode op_code)
         case 0x33: return eCode::_FX33;
         case 0x55: return eCode::_FX55;
         case 0x65: return eCode::_FX65;
+        case 0x30: return eCode::_FX30;
+        case 0x75: return eCode::_FX75;
+        case 0x85: return eCode::_FX85;
+        case 0x00: return Chip8::xo_chip && op_code.x() == 0x0 ? eCode::_F000 : eCode::UNKOWN;
+        case 0x01: return Chip8::xo_chip ? eCode::_FN01 : eCode::UNKOWN;
+        case 0x02: return Chip8::xo_chip && op_code.x() == 0x0 ? eCode::_F002 : eCode::UNKOWN;
+        case 0x3A: return Chip8::xo_chip ? eCode::_FX3A : eCode::UNKOWN;
         }
     default: return eCode::UNKOWN;
     }
@@ -88,61 +96,46 @@ eCode mapping(const Instruction::OpCode op_code)
 }
 
 
-Instruction::OpCode::OpCode(uint16 data)
-    : m_data(data)
-{
-
-}
-
-uint16 Instruction::OpCode::data() const
-{
-    return m_data;
-}
-
-uint8 Instruction::OpCode::cmd() const
+Instruction::Instruction()
+    : m_table(&tables()[0])
 {
-    return (m_data & 0xF000) >> 12;
-}
 
-uint8 Instruction::OpCode::n() const
-{
-    return (m_data & 0x000F);
 }
 
-uint8 Instruction::OpCode::nn() const
+void Instruction::select(uint8 quirks)
 {
-    return (m_data & 0x00FF);
+    m_table = &tables()[quirks];
 }
 
-uint16 Instruction::OpCode::nnn() const
+const std::array<Instruction::Table, 16>& Instruction::tables()
 {
-    return (m_data & 0x0FFF);
-}
+    /* one table per quirk combination, quirk checks are resolved at compile time */
+    static const auto tables = []<std::size_t... Q>(std::index_sequence<Q...>)
+    {
+        std::array<Table, 16> tables;
+        (build<Q>(tables[Q]), ...);
+        return tables;
+    }(std::make_index_sequence<Chip8::quirk_count>());
 
-uint8 Instruction::OpCode::x() const
-{
-    return (m_data & 0x0F00) >> 8;
+    return tables;
 }
 
-uint8 Instruction::OpCode::y() const
+template<uint8 Quirks>
+void Instruction::build(Table& table)
 {
-    return (m_data & 0x00F0) >> 4;
-}
-
+    table[detail::eCode::UNKOWN].m_op_code = "UNKNOWN";
 
-Instruction::Instruction()
-{
-    m_table[detail::eCode::_00E0] =
+    table[detail::eCode::_00E0] =
     {
         "00E0",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            std::memset(chip8.m_display.data(), false, Chip8::width_res*Chip8::height_res);
+            chip8.m_display.clear();
             return 2;
         }
     };
 
-    m_table[detail::eCode::_00EE] =
+    table[detail::eCode::_00EE] =
     {
         "00EE",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -154,7 +147,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_1NNN] =
+    table[detail::eCode::_1NNN] =
     {
         "1NNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -164,7 +157,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_2NNN] =
+    table[detail::eCode::_2NNN] =
     {
         "2NNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -176,34 +169,34 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_3XNN] =
+    table[detail::eCode::_3XNN] =
     {
         "3XNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * (chip8.m_register.V[op_code.x()] == op_code.nn());
+            return 2 + chip8.skip_size(chip8.m_register.PC) * (chip8.m_register.V[op_code.x()] == op_code.nn());
         }
     };
 
-    m_table[detail::eCode::_4XNN] =
+    table[detail::eCode::_4XNN] =
     {
         "4XNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * (chip8.m_register.V[op_code.x()] != op_code.nn());
+            return 2 + chip8.skip_size(chip8.m_register.PC) * (chip8.m_register.V[op_code.x()] != op_code.nn());
         }
     };
 
-    m_table[detail::eCode::_5XY0] =
+    table[detail::eCode::_5XY0] =
     {
         "5XY0",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * (chip8.m_register.V[op_code.x()] == chip8.m_register.V[op_code.y()]);
+            return 2 + chip8.skip_size(chip8.m_register.PC) * (chip8.m_register.V[op_code.x()] == chip8.m_register.V[op_code.y()]);
         }
     };
 
-    m_table[detail::eCode::_6XNN] =
+    table[detail::eCode::_6XNN] =
     {
         "6XNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -213,7 +206,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_7XNN] =
+    table[detail::eCode::_7XNN] =
     {
         "7XNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -223,7 +216,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XY0] =
+    table[detail::eCode::_8XY0] =
     {
         "8XY0",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -233,40 +226,40 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XY1] =
+    table[detail::eCode::_8XY1] =
     {
         "8XY1",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
             chip8.m_register.V[op_code.x()] |= chip8.m_register.V[op_code.y()];
-            if(chip8.m_settings.m_vf_reset) chip8.m_register.V[0xF] = 0;
+            if constexpr(Quirks & Chip8::QUIRK_VF_RESET) chip8.m_register.V[0xF] = 0;
             return 2;
         }
     };
 
-    m_table[detail::eCode::_8XY2] =
+    table[detail::eCode::_8XY2] =
     {
         "8XY2",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
             chip8.m_register.V[op_code.x()] &= chip8.m_register.V[op_code.y()];
-            if(chip8.m_settings.m_vf_reset) chip8.m_register.V[0xF] = 0;
+            if constexpr(Quirks & Chip8::QUIRK_VF_RESET) chip8.m_register.V[0xF] = 0;
             return 2;
         }
     };
 
-    m_table[detail::eCode::_8XY3] =
+    table[detail::eCode::_8XY3] =
     {
         "8XY3",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
             chip8.m_register.V[op_code.x()] ^= chip8.m_register.V[op_code.y()];
-            if(chip8.m_settings.m_vf_reset) chip8.m_register.V[0xF] = 0;
+            if constexpr(Quirks & Chip8::QUIRK_VF_RESET) chip8.m_register.V[0xF] = 0;
             return 2;
         }
     };
 
-    m_table[detail::eCode::_8XY4] =
+    table[detail::eCode::_8XY4] =
     {
         "8XY4",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -280,7 +273,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XY5] =
+    table[detail::eCode::_8XY5] =
     {
         "8XY5",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -294,12 +287,12 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XY6] =
+    table[detail::eCode::_8XY6] =
     {
         "8XY6",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            if(chip8.m_settings.m_shifting)
+            if constexpr(Quirks & Chip8::QUIRK_SHIFTING)
             {
                 auto& vx = chip8.m_register.V[op_code.x()];
                 chip8.m_register.V[0xF] = vx & 0x1;
@@ -317,7 +310,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XY7] =
+    table[detail::eCode::_8XY7] =
     {
         "8XY7",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -331,12 +324,12 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_8XYE] =
+    table[detail::eCode::_8XYE] =
     {
         "8XYE",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            if(chip8.m_settings.m_shifting)
+            if constexpr(Quirks & Chip8::QUIRK_SHIFTING)
             {
                 auto& vx = chip8.m_register.V[op_code.x()];
                 chip8.m_register.V[0xF] = vx >> 7;
@@ -354,16 +347,16 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_9XY0] =
+    table[detail::eCode::_9XY0] =
     {
         "9XY0",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * (chip8.m_register.V[op_code.x()] != chip8.m_register.V[op_code.y()]);
+            return 2 + chip8.skip_size(chip8.m_register.PC) * (chip8.m_register.V[op_code.x()] != chip8.m_register.V[op_code.y()]);
         }
     };
 
-    m_table[detail::eCode::_ANNN] =
+    table[detail::eCode::_ANNN] =
     {
         "ANNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -373,75 +366,60 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_BNNN] =
+    table[detail::eCode::_BNNN] =
     {
         "BNNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            if(chip8.m_settings.m_jumping) chip8.m_register.PC = chip8.m_register.V[op_code.x()] + op_code.nnn();
+            if constexpr(Quirks & Chip8::QUIRK_JUMPING) chip8.m_register.PC = chip8.m_register.V[op_code.x()] + op_code.nnn();
             else chip8.m_register.PC = chip8.m_register.V[0] + op_code.nnn();
             return 0;
         }
     };
 
-    m_table[detail::eCode::_CXNN] =
+    table[detail::eCode::_CXNN] =
     {
         "CXNN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            chip8.m_register.V[op_code.x()] = (rand() % 0xFF) & op_code.nn();
+            chip8.m_register.V[op_code.x()] = (chip8.random() % 0xFF) & op_code.nn();
             return 2;
         }
     };
 
-    m_table[detail::eCode::_DXYN] =
+    table[detail::eCode::_DXYN] =
     {
         "DXYN",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            const auto vx = chip8.m_register.V[op_code.x()] % 64;
-            const auto vy = chip8.m_register.V[op_code.y()] % 32;
-            const auto I = chip8.m_register.I;
-            const auto height = op_code.n();
-
-            chip8.m_register.V[0xF] = 0;
-
-            for(int y = 0; y < height; y++)
-            {
-                auto pixel = chip8.m_memory[I + y];
-                for(int x = 0; x < 8; x++)
-                {
-                    bool draw = (pixel & (0x80 >> x)) != 0;
-                    auto index = vx + x + (vy + y) * Chip8::width_res;
+            const auto vx = chip8.m_register.V[op_code.x()];
+            const auto vy = chip8.m_register.V[op_code.y()];
 
-                    chip8.m_register.V[0xF] = chip8.m_register.V[0xF] || (chip8.m_display[index] && draw);
-                    chip8.m_display[index] ^= draw;
-                }
-            }
+            chip8.m_register.V[0xF] = chip8.draw_sprite(vx, vy, chip8.m_register.I, op_code.n());
 
             return 2;
         }
     };
 
-    m_table[detail::eCode::_EX9E] =
+    table[detail::eCode::_EX9E] =
     {
         "EX9E",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * chip8.m_keypad[ chip8.m_register.V[op_code.x()] ];
+            return 2 + chip8.skip_size(chip8.m_register.PC) * chip8.m_keypad[ chip8.m_register.V[op_code.x()] ];
         }
     };
 
-    m_table[detail::eCode::_EXA1] =
+    table[detail::eCode::_EXA1] =
     {
         "EXA1",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
-            return 2 + 2 * !chip8.m_keypad[ chip8.m_register.V[op_code.x()] ];
+            return 2 + chip8.skip_size(chip8.m_register.PC) * !chip8.m_keypad[ chip8.m_register.V[op_code.x()] ];
         }
     };
 
-    m_table[detail::eCode::_FX07] =
+    table[detail::eCode::_FX07] =
     {
         "FX07",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -451,7 +429,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX0A] =
+    table[detail::eCode::_FX0A] =
     {
         "FX0A",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -471,7 +449,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX15] =
+    table[detail::eCode::_FX15] =
     {
         "FX15",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -481,7 +459,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX18] =
+    table[detail::eCode::_FX18] =
     {
         "FX18",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -491,7 +469,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX1E] =
+    table[detail::eCode::_FX1E] =
     {
         "FX1E",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -505,7 +483,7 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX29] =
+    table[detail::eCode::_FX29] =
     {
         "FX29",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -515,22 +493,23 @@ Instruction::Instruction()
         }
     };
 
-    m_table[detail::eCode::_FX33] =
+    table[detail::eCode::_FX33] =
     {
         "FX33",
         [](Chip8& chip8, const OpCode op_code) -> uint16
         {
             const auto vx = chip8.m_register.V[ op_code.x() ];
 
-            chip8.m_memory[ chip8.m_register.I + 0 ] = vx / 100;
-            chip8.m_memory[ chip8.m_register.I + 1 ] = (vx / 10) % 10;
-            chip8.m_memory[ chip8.m_register.I + 2 ] = (vx % 100) % 10;
+            chip8.m_memory[ (chip8.m_register.I + 0) & Chip8::memory_mask ] = vx / 100;
+            chip8.m_memory[ (chip8.m_register.I + 1) & Chip8::memory_mask ] = (vx / 10) % 10;
+            chip8.m_memory[ (chip8.m_register.I + 2) & Chip8::memory_mask ] = (vx % 100) % 10;
+            chip8.invalidate(chip8.m_register.I, 3);
 
             return 2;
         }
     };
 
-    m_table[detail::eCode::_FX55] =
+    table[detail::eCode::_FX55] =
     {
         "FX55",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -539,16 +518,17 @@ Instruction::Instruction()
 
             for(int i = 0; i <= x; i++)
             {
-                chip8.m_memory[ chip8.m_register.I + i ] = chip8.m_register.V[i];
+                chip8.m_memory[ (chip8.m_register.I + i) & Chip8::memory_mask ] = chip8.m_register.V[i];
             }
+            chip8.invalidate(chip8.m_register.I, x + 1);
 
-            if(chip8.m_settings.m_memory) chip8.m_register.I += x + 1;
+            if constexpr(Quirks & Chip8::QUIRK_MEMORY) chip8.m_register.I += x + 1;
 
             return 2;
         }
     };
 
-    m_table[detail::eCode::_FX65] =
+    table[detail::eCode::_FX65] =
     {
         "FX65",
         [](Chip8& chip8, const OpCode op_code) -> uint16
@@ -557,19 +537,228 @@ Instruction::Instruction()
 
             for(int i = 0; i <= x; i++)
             {
-                chip8.m_register.V[i] = chip8.m_memory[ chip8.m_register.I + i ];
+                chip8.m_register.V[i] = chip8.m_memory[ (chip8.m_register.I + i) & Chip8::memory_mask ];
+            }
+
+            if constexpr(Quirks & Chip8::QUIRK_MEMORY) chip8.m_register.I += x + 1;
+
+            return 2;
+        }
+    };
+
+    /***** SUPER-CHIP *****/
+    table[detail::eCode::_00CN] =
+    {
+        "00CN",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.scroll_down(op_code.n());
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_00FB] =
+    {
+        "00FB",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.scroll_right(4);
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_00FC] =
+    {
+        "00FC",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.scroll_left(4);
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_00FD] =
+    {
+        "00FD",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            /* exit: the program stays here */
+            return 0;
+        }
+    };
+
+    table[detail::eCode::_00FE] =
+    {
+        "00FE",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.resolution(false);
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_00FF] =
+    {
+        "00FF",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.resolution(true);
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_FX30] =
+    {
+        "FX30",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_register.I = Chip8::big_font_addr + (chip8.m_register.V[op_code.x()] & 0xF) * 10;
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_FX75] =
+    {
+        "FX75",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            for(int i = 0; i <= op_code.x(); i++)
+            {
+                chip8.m_flags[i] = chip8.m_register.V[i];
             }
 
-            if(chip8.m_settings.m_memory) chip8.m_register.I += x + 1;
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_FX85] =
+    {
+        "FX85",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            for(int i = 0; i <= op_code.x(); i++)
+            {
+                chip8.m_register.V[i] = chip8.m_flags[i];
+            }
 
             return 2;
         }
     };
+
+    /***** XO-CHIP *****/
+    table[detail::eCode::_00DN] =
+    {
+        "00DN",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.scroll_up(op_code.n());
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_5XY2] =
+    {
+        "5XY2",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            /* vx to vy (descending if x > y), I is left unchanged */
+            const int x = op_code.x();
+            const int y = op_code.y();
+            const int step = x <= y ? 1 : -1;
+            const int count = (y - x) * step + 1;
+
+            for(int i = 0; i < count; i++)
+            {
+                chip8.m_memory[ (chip8.m_register.I + i) & Chip8::memory_mask ] = chip8.m_register.V[x + i * step];
+            }
+            chip8.invalidate(chip8.m_register.I, count);
+
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_5XY3] =
+    {
+        "5XY3",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            const int x = op_code.x();
+            const int y = op_code.y();
+            const int step = x <= y ? 1 : -1;
+            const int count = (y - x) * step + 1;
+
+            for(int i = 0; i < count; i++)
+            {
+                chip8.m_register.V[x + i * step] = chip8.m_memory[ (chip8.m_register.I + i) & Chip8::memory_mask ];
+            }
+
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_F000] =
+    {
+        "F000",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            /* the address is the second word of the instruction */
+            const uint16 addr = chip8.m_register.PC + 2;
+            chip8.m_register.I = chip8.m_memory[addr] << 8 | chip8.m_memory[uint16(addr + 1)];
+            return 4;
+        }
+    };
+
+    table[detail::eCode::_FN01] =
+    {
+        "FN01",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_display.m_mask = op_code.x() & 0x3;
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_F002] =
+    {
+        "F002",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            auto& audio = chip8.m_audio;
+            for(std::size_t i = 0; i < audio.m_pattern.size(); i++)
+            {
+                audio.m_pattern[i] = chip8.m_memory[ (chip8.m_register.I + i) & Chip8::memory_mask ];
+            }
+            audio.m_loaded = true;
+
+            return 2;
+        }
+    };
+
+    table[detail::eCode::_FX3A] =
+    {
+        "FX3A",
+        [](Chip8& chip8, const OpCode op_code) -> uint16
+        {
+            chip8.m_audio.m_pitch = chip8.m_register.V[op_code.x()];
+            return 2;
+        }
+    };
 }
 
 const Instruction::Operation& Instruction::decode(const OpCode op_code)
 {
-    return m_table[ detail::mapping(op_code) ];
+    return (*m_table)[ detail::mapping(op_code) ];
+}
+
+Instruction::Decoded Instruction::predecode(const OpCode op_code)
+{
+    const auto code = detail::mapping(op_code);
+    return { (*m_table)[code].m_exec, op_code, code };
+}
+
+const char* Instruction::name(detail::eCode code)
+{
+    return tables()[0][code].m_op_code.c_str();
 }
 
 }
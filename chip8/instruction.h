@@ -11,13 +11,34 @@ namespace emu
 
 struct Chip8;
 
+namespace detail
+{
+
+/* instruction table index (also used as dispatch label index by the threaded core) */
+enum eCode : int
+{
+    _00E0 = 0, _00EE,
+    _1NNN,_2NNN, _3XNN, _4XNN, _5XY0, _6XNN, _7XNN,
+    _8XY0, _8XY1, _8XY2, _8XY3, _8XY4, _8XY5, _8XY6, _8XY7, _8XYE,
+    _9XY0,
+    _ANNN, _BNNN, _CXNN, _DXYN,
+    _EX9E, _EXA1,
+    _FX07, _FX0A, _FX15, _FX18, _FX1E, _FX29, _FX33, _FX55, _FX65,
+    _00CN, _00FB, _00FC, _00FD, _00FE, _00FF, _FX30, _FX75, _FX85,     /* SUPER-CHIP */
+    _00DN, _5XY2, _5XY3, _F000, _FN01, _F002, _FX3A,                   /* XO-CHIP (CHIP8_XOCHIP builds only) */
+    UNKOWN
+};
+
+}
+
 /*
  *  Chip8 Instruction set (Table):
  *  -----------------------------
  *    -> Maintains mapping from op code to C++ function
  *
- *    - 35 different instructions (math, graphics, control)
- *    - instructions are 2 bytes long and are stored most-significant-byte first
+ *    - 35 different instructions (math, graphics, control) and 9 SUPER-CHIP extensions (DXY0 is handled by DXYN)
+ *    - 7 XO-CHIP extensions, decoded in CHIP8_XOCHIP builds only
+ *    - instructions are 2 bytes long (XO-CHIP F000 NNNN: 4 bytes) and are stored most-significant-byte first
  *
  *    References:
  *      - https://github.com/mattmikolay/chip-8/wiki/CHIP%E2%80%908-Technical-Reference
@@ -32,7 +53,7 @@ struct Instruction
     /* OP Code Parsing Helper */
     struct OpCode
     {
-        OpCode(uint16 data);
+        OpCode(uint16 data = 0);
 
         uint16 data() const;
         uint8 cmd() const;
@@ -43,7 +64,13 @@ struct Instruction
         uint8 y() const;
 
     private:
+        /* operands are extracted once at construction (cheap to pass around / cache) */
         uint16 m_data;
+        uint16 m_nnn;
+        uint8 m_x;
+        uint8 m_y;
+        uint8 m_nn;
+        uint8 m_n;
     };
 
     /* Instruction Info and Code */
@@ -53,15 +80,90 @@ struct Instruction
         uint16 (*m_exec)(Chip8& chip8, const OpCode op_code) = [](Chip8& chip8, const OpCode op_code) -> uint16 { assert(false); return 0; };
     };
 
+    /* Predecoded Instruction (handler and extracted operands, cached by Chip8 per even address) */
+    struct Decoded
+    {
+        uint16 (*m_exec)(Chip8& chip8, const OpCode op_code) = nullptr;
+        OpCode m_op_code;
+        detail::eCode m_code = detail::eCode::UNKOWN;
+    };
+
 
 public:
     Instruction();
 
+    /* select the handlers specialized for the active quirks (Chip8::eQuirk bitmask) */
+    void select(uint8 quirks);
+
     /* retrieve function from operation code (called by Chip8 execute_cycle) */
     const Operation& decode(const OpCode op_code);
 
+    /* decode into a cache entry (called by Chip8 whenever the underlying memory changes) */
+    Decoded predecode(const OpCode op_code);
+
+    /* opcode pattern of an eCode ("8XY4", "UNKNOWN"; used by the profile and the benchmarks) */
+    static const char* name(detail::eCode code);
+
+private:
+    using Table = std::array<Operation, detail::eCode::UNKOWN + 1>;
+
+    /* one table per quirk combination (indexed by quirk bitmask), built once and shared by all instances */
+    static const std::array<Table, 16>& tables();
+
+    /* fill a table with handlers for one quirk combination */
+    template<uint8 Quirks>
+    static void build(Table& table);
+
 private:
-    std::array<Operation, 35> m_table;
+    const Table* m_table;               /* table of the active quirks */
 };
 
+
+/* operand accessors are inline, they sit on the hot path of every core */
+inline Instruction::OpCode::OpCode(uint16 data)
+    : m_data(data),
+      m_nnn(data & 0x0FFF),
+      m_x((data & 0x0F00) >> 8),
+      m_y((data & 0x00F0) >> 4),
+      m_nn(data & 0x00FF),
+      m_n(data & 0x000F)
+{
+
+}
+
+inline uint16 Instruction::OpCode::data() const
+{
+    return m_data;
+}
+
+inline uint8 Instruction::OpCode::cmd() const
+{
+    return (m_data & 0xF000) >> 12;
+}
+
+inline uint8 Instruction::OpCode::n() const
+{
+    return m_n;
+}
+
+inline uint8 Instruction::OpCode::nn() const
+{
+    return m_nn;
+}
+
+inline uint16 Instruction::OpCode::nnn() const
+{
+    return m_nnn;
+}
+
+inline uint8 Instruction::OpCode::x() const
+{
+    return m_x;
+}
+
+inline uint8 Instruction::OpCode::y() const
+{
+    return m_y;
+}
+
 }
@@ -0,0 +1,487 @@
+#include "jit.h"
+
+#include "chip8.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CHIP8_JIT_X64 1
+#include <sys/mman.h>
+#else
+#define CHIP8_JIT_X64 0
+#endif
+
+namespace emu
+{
+
+namespace detail
+{
+
+/* maximum number of instructions translated into one block */
+constexpr int jit_max_block = 64;
+
+/* upper bound of emitted bytes per instruction (FX65 with x = F) */
+constexpr std::size_t jit_max_instruction = 400;
+
+constexpr std::size_t jit_buffer_size = 1 << 20;
+
+/*
+ *  Minimal x86-64 emitter:
+ *  -----------------------------
+ *    - rbx holds the Chip8 pointer for the whole block
+ *    - eax, ecx, esi, edi are scratch
+ *    - register field: 0 = eax, 1 = ecx
+ */
+struct Emitter
+{
+    enum eReg : uint8 { EAX = 0, ECX = 1 };
+    enum eCond : uint8 { B = 0x2, E = 0x4, NE = 0x5, BE = 0x6, A = 0x7 };
+
+    uint8* m_ptr;
+
+    void u8(uint8 v) { *m_ptr++ = v; }
+    void u16(uint16 v) { std::memcpy(m_ptr, &v, 2); m_ptr += 2; }
+    void u32(uint32 v) { std::memcpy(m_ptr, &v, 4); m_ptr += 4; }
+    void u64(uint64 v) { std::memcpy(m_ptr, &v, 8); m_ptr += 8; }
+
+    /* modrm for [rbx + disp32] */
+    void rbx(uint8 reg, int32 disp) { u8(0x80 | (reg << 3) | 0x3); u32(disp); }
+
+    /* push rbx; mov rbx, rdi */
+    void prologue() { u8(0x53); u8(0x48); u8(0x89); u8(0xFB); }
+    /* pop rbx; ret */
+    void epilogue() { u8(0x5B); u8(0xC3); }
+
+    /* movzx reg, byte/word [rbx + disp] */
+    void load8(eReg reg, int32 disp) { u8(0x0F); u8(0xB6); rbx(reg, disp); }
+    void load16(eReg reg, int32 disp) { u8(0x0F); u8(0xB7); rbx(reg, disp); }
+
+    /* movzx reg, byte [rbx + index + disp] */
+    void load8_indexed(eReg reg, eReg index, int32 disp) { u8(0x0F); u8(0xB6); u8(0x84 | (reg << 3)); u8((index << 3) | 0x3); u32(disp); }
+
+    /* mov byte/word [rbx + disp], reg */
+    void store8(int32 disp, eReg reg) { u8(0x88); rbx(reg, disp); }
+    void store16(int32 disp, eReg reg) { u8(0x66); u8(0x89); rbx(reg, disp); }
+
+    /* mov byte/word [rbx + disp], imm */
+    void store8_imm(int32 disp, uint8 imm) { u8(0xC6); rbx(0, disp); u8(imm); }
+    void store16_imm(int32 disp, uint16 imm) { u8(0x66); u8(0xC7); rbx(0, disp); u16(imm); }
+
+    /* add/or/and/sub/xor/cmp al, byte [rbx + disp] */
+    void add8(int32 disp) { u8(0x02); rbx(EAX, disp); }
+    void or8(int32 disp) { u8(0x0A); rbx(EAX, disp); }
+    void and8(int32 disp) { u8(0x22); rbx(EAX, disp); }
+    void sub8(int32 disp) { u8(0x2A); rbx(EAX, disp); }
+    void xor8(int32 disp) { u8(0x32); rbx(EAX, disp); }
+    void cmp8(int32 disp) { u8(0x3A); rbx(EAX, disp); }
+
+    /* add/cmp byte [rbx + disp], imm8 */
+    void add8_imm(int32 disp, uint8 imm) { u8(0x80); rbx(0, disp); u8(imm); }
+    void cmp8_imm(int32 disp, uint8 imm) { u8(0x80); rbx(7, disp); u8(imm); }
+
+    /* add/sub word [rbx + disp], imm8 (sign extended) */
+    void add16_imm(int32 disp, uint8 imm) { u8(0x66); u8(0x83); rbx(0, disp); u8(imm); }
+    void sub16_imm(int32 disp, uint8 imm) { u8(0x66); u8(0x83); rbx(5, disp); u8(imm); }
+
+    /* add word [rbx + disp], ax */
+    void add16_ax(int32 disp) { u8(0x66); u8(0x01); rbx(EAX, disp); }
+
+    /* setcc reg8 */
+    void set(eCond cond, eReg reg) { u8(0x0F); u8(0x90 | cond); u8(0xC0 | reg); }
+
+    /* movzx ecx, cl */
+    void zext_cl() { u8(0x0F); u8(0xB6); u8(0xC9); }
+    /* xor ecx, 1 */
+    void not_cl() { u8(0x83); u8(0xF1); u8(0x01); }
+
+    /* and al, imm8 / shr al, imm8 / add al, al */
+    void and_al(uint8 imm) { u8(0x24); u8(imm); }
+    void shr_al(uint8 imm) { u8(0xC0); u8(0xE8); u8(imm); }
+    void shl_al() { u8(0x00); u8(0xC0); }
+
+    /* add eax, imm32 / and eax, imm32 */
+    void add_eax(uint32 imm) { u8(0x05); u32(imm); }
+    void and_eax(uint32 imm) { u8(0x25); u32(imm); }
+    /* lea eax, [rcx + imm8] */
+    void lea_eax_rcx(uint8 disp) { u8(0x8D); u8(0x41); u8(disp); }
+    /* lea eax, [rax + rax*4] */
+    void mul5_eax() { u8(0x8D); u8(0x04); u8(0x80); }
+    /* lea eax, [rcx*2 + imm32] / lea eax, [rcx*4 + imm32] (skip over a 2 or 4 byte instruction) */
+    void skip_eax(uint32 base, uint16 size = 2) { u8(0x8D); u8(0x04); u8(size == 4 ? 0x8D : 0x4D); u32(base); }
+
+    /* movzx eax, word [rbx + rax*2 + disp] / mov word [rbx + rax*2 + disp], imm16 */
+    void load16_stack(int32 disp) { u8(0x0F); u8(0xB7); u8(0x84); u8(0x43); u32(disp); }
+    void store16_stack_imm(int32 disp, uint16 imm) { u8(0x66); u8(0xC7); u8(0x84); u8(0x43); u32(disp); u16(imm); }
+
+    /* handler(*rbx, op_code): OpCode is trivially copyable and 8 bytes, passed in rsi */
+    void call(uint16 (*fn)(Chip8&, const Instruction::OpCode), const Instruction::OpCode op_code)
+    {
+        static_assert(sizeof(Instruction::OpCode) == 8);
+
+        uint64 arg;
+        std::memcpy(&arg, &op_code, sizeof(arg));
+
+        u8(0x48); u8(0x89); u8(0xDF);                           /* mov rdi, rbx */
+        u8(0x48); u8(0xBE); u64(arg);                           /* mov rsi, imm64 */
+        u8(0x48); u8(0xB8); u64(reinterpret_cast<uint64>(fn));  /* mov rax, imm64 */
+        u8(0xFF); u8(0xD0);                                     /* call rax */
+    }
+};
+
+}
+
+
+Jit::Jit(const Chip8& chip8)
+{
+    const auto base = reinterpret_cast<const uint8*>(&chip8);
+    const auto offset = [base](const void* ptr) { return static_cast<int32>(reinterpret_cast<const uint8*>(ptr) - base); };
+
+    m_offset.m_V = offset(chip8.m_register.V.data());
+    m_offset.m_I = offset(&chip8.m_register.I);
+    m_offset.m_PC = offset(&chip8.m_register.PC);
+    m_offset.m_SP = offset(&chip8.m_register.SP);
+    m_offset.m_delay = offset(&chip8.m_register.timer_delay);
+    m_offset.m_sound = offset(&chip8.m_register.timer_sound);
+    m_offset.m_stack = offset(chip8.m_stack.data());
+    m_offset.m_keypad = offset(chip8.m_keypad.data());
+    m_offset.m_memory = offset(chip8.m_memory.data());
+
+    m_blocks.resize(Chip8::memory_size / 2);
+    m_covered.resize(Chip8::memory_size, 0);
+
+#if CHIP8_JIT_X64
+    void* buffer = mmap(nullptr, detail::jit_buffer_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buffer != MAP_FAILED)
+    {
+        m_buffer = static_cast<uint8*>(buffer);
+        m_buffer_size = detail::jit_buffer_size;
+    }
+#endif
+}
+
+Jit::~Jit()
+{
+#if CHIP8_JIT_X64
+    if(m_buffer) munmap(m_buffer, m_buffer_size);
+#endif
+}
+
+bool Jit::supported()
+{
+    return CHIP8_JIT_X64;
+}
+
+int Jit::execute(Chip8& chip8, int cycles)
+{
+    /* FX0A is always interpreted, so only a step can start waiting */
+    const auto step = [&chip8, &cycles]()
+    {
+        chip8.step();
+        cycles--;
+        return !chip8.m_await_interrupt;
+    };
+
+    if(!m_buffer)
+    {
+        while(cycles > 0 && step()) {}
+        return std::max(cycles, 0);
+    }
+
+    while(cycles > 0)
+    {
+        const auto pc = chip8.m_register.PC;
+        if((pc & 0x1) || pc >= Chip8::memory_size - 1)
+        {
+            if(!step()) break;
+            continue;
+        }
+
+        auto& block = m_blocks[pc >> 1];
+        if(!block.m_valid) compile(chip8, pc);
+
+        /* interpret single instructions if the block would overrun the budget */
+        if(block.m_count == 0 || block.m_count > cycles)
+        {
+            if(!step()) break;
+            continue;
+        }
+
+        /* a block runs all of its instructions (control flow only at its end) */
+        if constexpr(Chip8::profiling)
+        {
+            for(uint32 addr = pc, i = 0; i < block.m_count; i++)
+            {
+                const auto& decoded = chip8.m_decoded[addr >> 1];
+                chip8.m_profile->count(addr, decoded);
+                addr += decoded.m_code == detail::eCode::_F000 ? 4 : 2;
+            }
+        }
+
+        /* the block may invalidate itself (FX33, FX55) */
+        cycles -= block.m_count;
+        block.m_code(&chip8);
+    }
+
+    return std::max(cycles, 0);
+}
+
+void Jit::invalidate(uint16 addr, uint32 size)
+{
+    const uint32 end = std::min<uint32>(uint32(addr) + size, Chip8::memory_size);
+
+    bool covered = false;
+    for(uint32 a = addr; a < end && !covered; a++) covered = m_covered[a] != 0;
+    if(!covered) return;
+
+    /* remove overlapping blocks (code stays in the buffer until the next flush) */
+    auto it = std::remove_if(m_live.begin(), m_live.end(), [&](uint16 start)
+    {
+        auto& block = m_blocks[start >> 1];
+        if(start >= end || block.m_end <= addr) return false;
+
+        for(uint32 a = start; a < block.m_end; a++) m_covered[a]--;
+        block = Block();
+        return true;
+    });
+    m_live.erase(it, m_live.end());
+}
+
+void Jit::flush()
+{
+    std::fill(m_blocks.begin(), m_blocks.end(), Block());
+    std::fill(m_covered.begin(), m_covered.end(), 0);
+    m_live.clear();
+    m_buffer_used = 0;
+}
+
+void Jit::compile(const Chip8& chip8, uint16 pc)
+{
+    using detail::eCode;
+    using E = detail::Emitter;
+
+    auto& block = m_blocks[pc >> 1];
+
+    /* make room (all blocks are dropped, none is executing during compilation) */
+    if(m_buffer_size - m_buffer_used < detail::jit_max_block * detail::jit_max_instruction)
+    {
+        flush();
+    }
+
+#if CHIP8_JIT_X64
+    mprotect(m_buffer, m_buffer_size, PROT_READ | PROT_WRITE);
+#endif
+
+    const auto& o = m_offset;
+    const auto V = [&o](uint8 x) { return o.m_V + x; };
+    const auto quirks = chip8.m_quirks;
+
+    uint8* start = m_buffer + m_buffer_used;
+    E e{ start };
+    e.prologue();
+
+    uint32 addr = pc;
+    uint32 end = pc;
+    int count = 0;
+    bool terminated = false;
+
+    while(!terminated && count < detail::jit_max_block && addr < Chip8::memory_size - 1)
+    {
+        const auto& decoded = chip8.m_decoded[addr >> 1];
+        const auto& op = decoded.m_op_code;
+        const auto code = decoded.m_code;
+        const auto x = op.x();
+        const auto y = op.y();
+        const uint32 next = addr + (code == eCode::_F000 ? 4 : 2);
+        const uint16 skip = chip8.skip_size(addr);
+
+        /* interpreted (may stall or assert): end block right before */
+        if(code == eCode::_FX0A || code == eCode::_00FD || code == eCode::UNKOWN) break;
+
+        switch(code)
+        {
+        /* straight-line */
+        case eCode::_6XNN: e.store8_imm(V(x), op.nn()); break;
+        case eCode::_7XNN: e.add8_imm(V(x), op.nn()); break;
+        case eCode::_8XY0: e.load8(E::EAX, V(y)); e.store8(V(x), E::EAX); break;
+
+        case eCode::_8XY1:
+        case eCode::_8XY2:
+        case eCode::_8XY3:
+            e.load8(E::EAX, V(x));
+            if(code == eCode::_8XY1) e.or8(V(y));
+            if(code == eCode::_8XY2) e.and8(V(y));
+            if(code == eCode::_8XY3) e.xor8(V(y));
+            e.store8(V(x), E::EAX);
+            if(quirks & Chip8::QUIRK_VF_RESET) e.store8_imm(V(0xF), 0);
+            break;
+
+        /* flag is written first, operands are re-read afterwards (x or y may be F) */
+        case eCode::_8XY4:
+            e.load8(E::EAX, V(x)); e.add8(V(y)); e.set(E::B, E::ECX); e.store8(V(0xF), E::ECX);
+            e.load8(E::EAX, V(x)); e.add8(V(y)); e.store8(V(x), E::EAX);
+            break;
+
+        case eCode::_8XY5:
+            e.load8(E::EAX, V(x)); e.cmp8(V(y)); e.set(E::A, E::ECX); e.store8(V(0xF), E::ECX);
+            e.load8(E::EAX, V(x)); e.sub8(V(y)); e.store8(V(x), E::EAX);
+            break;
+
+        case eCode::_8XY7:
+            e.load8(E::EAX, V(x)); e.cmp8(V(y)); e.set(E::BE, E::ECX); e.store8(V(0xF), E::ECX);
+            e.load8(E::EAX, V(y)); e.sub8(V(x)); e.store8(V(x), E::EAX);
+            break;
+
+        case eCode::_8XY6:
+        {
+            const auto src = (quirks & Chip8::QUIRK_SHIFTING) ? x : y;
+            e.load8(E::EAX, V(src)); e.and_al(0x1); e.store8(V(0xF), E::EAX);
+            e.load8(E::EAX, V(src)); e.shr_al(1); e.store8(V(x), E::EAX);
+            break;
+        }
+
+        case eCode::_8XYE:
+        {
+            const auto src = (quirks & Chip8::QUIRK_SHIFTING) ? x : y;
+            e.load8(E::EAX, V(src)); e.shr_al(7); e.store8(V(0xF), E::EAX);
+            e.load8(E::EAX, V(src)); e.shl_al(); e.store8(V(x), E::EAX);
+            break;
+        }
+
+        case eCode::_ANNN: e.store16_imm(o.m_I, op.nnn()); break;
+        case eCode::_FX07: e.load8(E::EAX, o.m_delay); e.store8(V(x), E::EAX); break;
+        case eCode::_FX15: e.load8(E::EAX, V(x)); e.store8(o.m_delay, E::EAX); break;
+        case eCode::_FX18: e.load8(E::EAX, V(x)); e.store8(o.m_sound, E::EAX); break;
+        case eCode::_FX1E: e.load8(E::EAX, V(x)); e.add16_ax(o.m_I); break;
+        case eCode::_FX29: e.load8(E::EAX, V(x)); e.mul5_eax(); e.store16(o.m_I, E::EAX); break;
+        case eCode::_F000: e.store16_imm(o.m_I, chip8.m_memory[(addr + 2) % Chip8::memory_size] << 8 | chip8.m_memory[(addr + 3) % Chip8::memory_size]); break;
+
+        case eCode::_FX65:
+            e.load16(E::ECX, o.m_I);
+            for(int i = 0; i <= x; i++)
+            {
+                /* memory[(I + i) & memory_mask] */
+                e.lea_eax_rcx(i);
+                e.and_eax(Chip8::memory_mask);
+                e.load8_indexed(E::EAX, E::EAX, o.m_memory);
+                e.store8(V(i), E::EAX);
+            }
+            if(quirks & Chip8::QUIRK_MEMORY) e.add16_imm(o.m_I, x + 1);
+            break;
+
+        /* interpreter handlers (no control flow, state lives in memory) */
+        case eCode::_00E0:
+        case eCode::_CXNN:
+        case eCode::_DXYN:
+        case eCode::_00CN:
+        case eCode::_00FB:
+        case eCode::_00FC:
+        case eCode::_00FE:
+        case eCode::_00FF:
+        case eCode::_FX30:
+        case eCode::_FX75:
+        case eCode::_FX85:
+        case eCode::_00DN:
+        case eCode::_5XY3:
+        case eCode::_FN01:
+        case eCode::_F002:
+        case eCode::_FX3A:
+            e.call(decoded.m_exec, op);
+            break;
+
+        /* memory writes: block ends, the write may invalidate it */
+        case eCode::_FX33:
+        case eCode::_FX55:
+        case eCode::_5XY2:
+            e.call(decoded.m_exec, op);
+            e.store16_imm(o.m_PC, next);
+            terminated = true;
+            break;
+
+        /* control flow */
+        case eCode::_1NNN:
+            e.store16_imm(o.m_PC, op.nnn());
+            terminated = true;
+            break;
+
+        case eCode::_2NNN:
+            e.load16(E::EAX, o.m_SP);
+            e.store16_stack_imm(o.m_stack, addr);
+            e.add16_imm(o.m_SP, 1);
+            e.store16_imm(o.m_PC, op.nnn());
+            terminated = true;
+            break;
+
+        case eCode::_00EE:
+            e.sub16_imm(o.m_SP, 1);
+            e.load16(E::EAX, o.m_SP);
+            e.load16_stack(o.m_stack);
+            e.add_eax(2);
+            e.store16(o.m_PC, E::EAX);
+            terminated = true;
+            break;
+
+        case eCode::_BNNN:
+            e.load8(E::EAX, V((quirks & Chip8::QUIRK_JUMPING) ? x : 0));
+            e.add_eax(op.nnn());
+            e.store16(o.m_PC, E::EAX);
+            terminated = true;
+            break;
+
+        /* skips: PC = next + skip * condition */
+        case eCode::_3XNN:
+        case eCode::_4XNN:
+            e.cmp8_imm(V(x), op.nn());
+            e.set(code == eCode::_3XNN ? E::E : E::NE, E::ECX);
+            e.zext_cl(); e.skip_eax(next, skip); e.store16(o.m_PC, E::EAX);
+            terminated = true;
+            break;
+
+        case eCode::_5XY0:
+        case eCode::_9XY0:
+            e.load8(E::EAX, V(x)); e.cmp8(V(y));
+            e.set(code == eCode::_5XY0 ? E::E : E::NE, E::ECX);
+            e.zext_cl(); e.skip_eax(next, skip); e.store16(o.m_PC, E::EAX);
+            terminated = true;
+            break;
+
+        case eCode::_EX9E:
+        case eCode::_EXA1:
+            e.load8(E::EAX, V(x));
+            e.load8_indexed(E::ECX, E::EAX, o.m_keypad);
+            if(code == eCode::_EXA1) e.not_cl();
+            e.skip_eax(next, skip); e.store16(o.m_PC, E::EAX);
+            terminated = true;
+            break;
+
+        default:
+            break;
+        }
+
+        addr = next;
+        count++;
+    }
+
+    if(!terminated) e.store16_imm(o.m_PC, addr);
+
+    /* XO-CHIP: a skip ending the block depends on the length of the instruction after it (F000 NNNN) */
+    if(terminated && Chip8::xo_chip) end = addr + 2;
+    e.epilogue();
+
+#if CHIP8_JIT_X64
+    mprotect(m_buffer, m_buffer_size, PROT_READ | PROT_EXEC);
+#endif
+
+    if(count > 0) m_buffer_used += e.m_ptr - start;
+
+    /* an empty block still depends on its first instruction */
+    block.m_valid = true;
+    block.m_count = count;
+    block.m_end = count > 0 ? std::min(std::max(addr, end), Chip8::memory_size) : pc + 2;
+    block.m_code = count > 0 ? reinterpret_cast<BlockFn>(start) : nullptr;
+
+    m_live.push_back(pc);
+    for(uint32 a = pc; a < block.m_end; a++) m_covered[a]++;
+}
+
+}
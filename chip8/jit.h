@@ -0,0 +1,87 @@
+#pragma once
+
+#include "base.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace emu
+{
+
+struct Chip8;
+
+/*
+ *  Chip8 Basic Block JIT (x86-64):
+ *  -----------------------------
+ *    -> translates straight-line runs of opcodes into native x86-64 code
+ *    -> a block ends at 1NNN, 2NNN, 00EE, BNNN, skip instructions and memory writes (FX33, FX55, 5XY2);
+ *       it stops right before FX0A, 00FD and unknown opcodes (those are interpreted)
+ *    -> XO-CHIP F000 NNNN is translated with its address operand, skips with the length of the instruction they jump over
+ *    -> registers stay in the Chip8 object and are addressed relative to it ([rbx + offset]),
+ *       so the interpreter handlers called for DXYN, CXNN, 00E0, FX33, FX55 and the SUPER-CHIP / XO-CHIP opcodes need no state sync
+ *    -> blocks are invalidated whenever memory they were translated from is written (Chip8::invalidate)
+ *       (a quirk change re-decodes all of memory, which drops every block)
+ *
+ *    On other platforms (or when the code buffer cannot be mapped) execute() falls back to the table interpreter.
+ *
+ *  -----------------------------
+ */
+struct Jit
+{
+    Jit(const Chip8& chip8);
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+    ~Jit();
+
+    /* true if native code can be generated on this platform */
+    static bool supported();
+
+    /* run cycles instructions (compiles blocks on demand); returns the instructions left when FX0A starts waiting */
+    int execute(Chip8& chip8, int cycles);
+
+    /* drop translated blocks overlapping [addr, addr + size) */
+    void invalidate(uint16 addr, uint32 size);
+
+    /* drop all translated blocks */
+    void flush();
+
+private:
+    using BlockFn = void (*)(Chip8* chip8);
+
+    struct Block
+    {
+        BlockFn m_code = nullptr;
+        uint32 m_end = 0;           /* first address after the translated range */
+        uint8 m_count = 0;          /* instructions executed by the block */
+        bool m_valid = false;       /* translated (m_count == 0: first instruction is interpreted) */
+    };
+
+    void compile(const Chip8& chip8, uint16 pc);
+
+
+private:
+    /* offsets of the Chip8 state relative to the object */
+    struct
+    {
+        int32 m_V;
+        int32 m_I;
+        int32 m_PC;
+        int32 m_SP;
+        int32 m_delay;
+        int32 m_sound;
+        int32 m_stack;
+        int32 m_keypad;
+        int32 m_memory;
+    } m_offset;
+
+    std::vector<Block> m_blocks;        /* one entry per even address */
+    std::vector<uint8> m_covered;       /* number of live blocks covering each byte */
+    std::vector<uint16> m_live;         /* start addresses of live blocks */
+
+    uint8* m_buffer = nullptr;
+    std::size_t m_buffer_size = 0;
+    std::size_t m_buffer_used = 0;
+};
+
+}
@@ -0,0 +1,125 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+namespace emu
+{
+
+namespace detail
+{
+
+/* non-zero counters as (index, count), highest count first */
+template<typename Counters>
+std::vector<std::pair<std::size_t, uint64>> sorted(const Counters& counters)
+{
+    std::vector<std::pair<std::size_t, uint64>> entries;
+    for(std::size_t i = 0; i < counters.size(); i++)
+    {
+        if(counters[i] > 0) entries.emplace_back(i, counters[i]);
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    return entries;
+}
+
+}
+
+
+Profile::Profile(std::size_t addresses)
+    : m_addresses(addresses, 0), m_calls(0x1000, 0)
+{
+
+}
+
+void Profile::clear()
+{
+    m_codes.fill(0);
+    std::fill(m_addresses.begin(), m_addresses.end(), 0);
+    std::fill(m_calls.begin(), m_calls.end(), 0);
+    m_waiting = 0;
+    m_idle = 0;
+    m_draw_time = 0;
+}
+
+uint64 Profile::instructions() const
+{
+    uint64 total = 0;
+    for(auto count : m_codes) total += count;
+    return total;
+}
+
+void Profile::report(std::ostream& stream, std::size_t top) const
+{
+    const auto total = instructions();
+    const auto draws = m_codes[detail::eCode::_DXYN];
+    const auto percent = [total](uint64 count) { return total > 0 ? 100.0 * count / total : 0.0; };
+
+    stream << "profile: " << total << " instructions (" << m_idle << " in skipped idle loops), "
+           << m_waiting << " waiting for a key\n"
+           << "         " << draws << " sprites drawn in " << m_draw_time / 1e6 << " ms ("
+           << (draws > 0 ? double(m_draw_time) / draws : 0.0) << " ns per sprite)\n";
+
+    stream << std::fixed << std::setprecision(1);
+
+    stream << "  opcodes:\n";
+    for(const auto& [code, count] : detail::sorted(m_codes))
+    {
+        stream << "    " << std::left << std::setw(8) << Instruction::name(detail::eCode(code)) << std::right
+               << std::setw(14) << count << std::setw(7) << percent(count) << "%\n";
+    }
+
+    const auto table = [&](const char* title, const std::vector<uint64>& counters)
+    {
+        const auto entries = detail::sorted(counters);
+        stream << "  " << title << " (top " << std::min(top, entries.size()) << " of " << entries.size() << "):\n";
+        for(std::size_t i = 0; i < std::min(top, entries.size()); i++)
+        {
+            stream << "    0x" << std::hex << std::setfill('0') << std::setw(4) << entries[i].first
+                   << std::dec << std::setfill(' ') << std::setw(16) << entries[i].second
+                   << std::setw(7) << percent(entries[i].second) << "%\n";
+        }
+    };
+
+    table("addresses", m_addresses);
+    table("call targets", m_calls);
+
+    stream << std::defaultfloat;
+}
+
+void Profile::json(std::ostream& stream) const
+{
+    stream << "{\n"
+           << "  \"instructions\": " << instructions() << ",\n"
+           << "  \"idle\": " << m_idle << ",\n"
+           << "  \"waiting\": " << m_waiting << ",\n"
+           << "  \"draw_ns\": " << m_draw_time << ",\n";
+
+    const auto entries = detail::sorted(m_codes);
+    stream << "  \"opcodes\": {";
+    for(std::size_t i = 0; i < entries.size(); i++)
+    {
+        stream << (i ? ", " : " ") << "\"" << Instruction::name(detail::eCode(entries[i].first)) << "\": " << entries[i].second;
+    }
+    stream << " },\n";
+
+    const auto list = [&stream](const char* title, const char* key, const std::vector<uint64>& counters, bool last)
+    {
+        const auto entries = detail::sorted(counters);
+        stream << "  \"" << title << "\": [";
+        for(std::size_t i = 0; i < entries.size(); i++)
+        {
+            stream << (i ? ",\n    " : "\n    ") << "{ \"" << key << "\": " << entries[i].first
+                   << ", \"count\": " << entries[i].second << " }";
+        }
+        stream << (entries.empty() ? "]" : "\n  ]") << (last ? "\n" : ",\n");
+    };
+
+    list("addresses", "pc", m_addresses, false);
+    list("calls", "target", m_calls, true);
+
+    stream << "}\n";
+}
+
+}
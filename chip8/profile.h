@@ -0,0 +1,59 @@
+#pragma once
+
+#include "instruction.h"
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Execution Profile (CHIP8_PROFILE builds):
+ *  -----------------------------
+ *    -> counts every instruction the cores execute per eCode, per address and per 2NNN call target
+ *       (all cores count the same instruction stream; iterations of an idle loop skipped by Settings::m_idle_skip
+ *       are added to the instructions of the loop)
+ *    -> instructions of ticks spent waiting in FX0A and host time spent drawing sprites (DXYN)
+ *    -> the opcode counts plus m_waiting add up to Chip8::instructions() (since the profile was cleared)
+ *    -> without CHIP8_PROFILE the counters and all hooks are compiled out, Chip8::profile() returns nullptr
+ *
+ *    Chip8Batch lanes are not profiled.
+ *  -----------------------------
+ */
+struct Profile
+{
+    /* addresses: size of the memory (a power of two) */
+    explicit Profile(std::size_t addresses);
+
+    /* an instruction at pc executed times times (called by the cores) */
+    void count(uint16 pc, const Instruction::Decoded& decoded, uint64 times = 1)
+    {
+        m_codes[decoded.m_code] += times;
+        m_addresses[pc & (m_addresses.size() - 1)] += times;
+        if(decoded.m_code == detail::eCode::_2NNN) m_calls[decoded.m_op_code.nnn()] += times;
+    }
+
+    void clear();
+
+    /* executed instructions (without the waiting ones) */
+    uint64 instructions() const;
+
+    /* totals, opcodes by count, the top hottest addresses and call targets */
+    void report(std::ostream& stream, std::size_t top = 16) const;
+
+    /* everything non-zero, sorted by count */
+    void json(std::ostream& stream) const;
+
+public:
+    std::array<uint64, detail::eCode::UNKOWN + 1> m_codes{};
+    std::vector<uint64> m_addresses;
+    std::vector<uint64> m_calls;        /* per 2NNN target */
+    uint64 m_waiting = 0;               /* instructions of ticks spent waiting for a key (FX0A) */
+    uint64 m_idle = 0;                  /* instructions skipped by the idle loop detection (part of the counts) */
+    uint64 m_draw_time = 0;             /* nanoseconds spent drawing sprites */
+};
+
+}
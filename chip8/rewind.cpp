@@ -0,0 +1,317 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace emu
+{
+
+namespace detail
+{
+
+/* run header: skipped words, literal words (16-bit each) */
+void put_run(uint8*& out, uint16 skip, uint16 literal)
+{
+    std::memcpy(out, &skip, sizeof(skip));
+    std::memcpy(out + 2, &literal, sizeof(literal));
+    out += 4;
+}
+
+void get_run(const uint8*& in, uint16& skip, uint16& literal)
+{
+    std::memcpy(&skip, in, sizeof(skip));
+    std::memcpy(&literal, in + 2, sizeof(literal));
+    in += 4;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+Rewind::Rewind(std::size_t capacity, std::size_t frames, uint32 keyframe_interval)
+    : m_ring(std::max(capacity, 2 * max_record)), m_entries(std::max<std::size_t>(frames, 2)), m_scratch(max_record),
+      m_keyframe_interval(std::max<uint32>(keyframe_interval, 1))
+{
+    m_key.fill(0);
+    m_image.fill(0);
+}
+
+void Rewind::record(const Chip8& chip8)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    capture(chip8, m_image);
+
+    bool keyframe = !m_key_valid || m_next - m_key_sequence >= m_keyframe_interval;
+    auto size = encode(m_image, keyframe ? nullptr : &m_key);
+
+    std::size_t offset = 0;
+    reserve(size, offset);
+
+    /* making room dropped the keyframe of this delta */
+    if(!keyframe && m_first > m_key_sequence)
+    {
+        keyframe = true;
+        size = encode(m_image, nullptr);
+        reserve(size, offset);
+    }
+
+    std::memcpy(m_ring.data() + offset, m_scratch.data(), size);
+    entry(m_next) = { offset, size, keyframe ? m_next : m_key_sequence };
+    m_head = offset + size;
+
+    if(keyframe)
+    {
+        m_key = m_image;
+        m_key_sequence = m_next;
+        m_key_valid = true;
+        m_stats.m_keyframes++;
+    }
+    m_next++;
+
+    const double seconds = detail::seconds_since(start);
+    m_stats.m_records++;
+    m_stats.m_bytes += size;
+    m_stats.m_record_time += seconds;
+    m_stats.m_record_max = std::max(m_stats.m_record_max, seconds);
+}
+
+bool Rewind::rewind(Chip8& chip8)
+{
+    if(frames() < 2) return false;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    /* the newest frame is the current state */
+    m_next--;
+    const auto& newest = entry(m_next - 1);
+
+    if(!m_key_valid || m_key_sequence != newest.m_keyframe)
+    {
+        m_key.fill(0);
+        decode(entry(newest.m_keyframe), m_key);
+        m_key_sequence = newest.m_keyframe;
+        m_key_valid = true;
+    }
+
+    m_image = m_key;
+    if(newest.m_keyframe != m_next - 1) decode(newest, m_image);
+
+    restore(m_image, chip8);
+    m_head = newest.m_offset + newest.m_size;
+
+    m_stats.m_rewinds++;
+    m_stats.m_rewind_time += detail::seconds_since(start);
+    return true;
+}
+
+void Rewind::clear()
+{
+    m_first = m_next = 0;
+    m_head = 0;
+    m_key_valid = false;
+}
+
+std::size_t Rewind::frames() const
+{
+    return m_next - m_first;
+}
+
+std::size_t Rewind::used() const
+{
+    if(m_first == m_next) return 0;
+
+    const auto tail = entry(m_first).m_offset;
+    return m_head > tail ? m_head - tail : m_ring.size() - tail + m_head;
+}
+
+std::size_t Rewind::capacity() const
+{
+    return m_ring.size();
+}
+
+const Rewind::Stats& Rewind::stats() const
+{
+    return m_stats;
+}
+
+void Rewind::capture(const Chip8& chip8, Image& image) const
+{
+    auto* bytes = reinterpret_cast<uint8*>(image.data());
+
+    /* padding between and after the flags */
+    std::memset(bytes + image_flags, 0, 8 * image_words - image_flags);
+    std::memcpy(bytes, chip8.m_memory.data(), Chip8::memory_size);
+    std::memcpy(bytes + Chip8::memory_size, chip8.m_display.m_planes.data(), image_display);
+    std::memcpy(bytes + image_registers, &chip8.m_register, sizeof(Chip8::Registers));
+    std::memcpy(bytes + image_stack, chip8.m_stack.data(), 16 * sizeof(uint16));
+    bytes[image_flags] = chip8.m_await_interrupt;
+    bytes[image_flags + 1] = chip8.m_tick_carry;
+    bytes[image_flags + 2] = chip8.m_display.m_hires;
+    bytes[image_flags + 3] = chip8.m_display.m_mask;
+    std::memcpy(bytes + image_flags + 4, &chip8.m_random, sizeof(uint32));
+    std::memcpy(bytes + image_flags + 8, chip8.m_flags.data(), 16);
+    std::memcpy(bytes + image_flags + 24, chip8.m_audio.m_pattern.data(), 16);
+    bytes[image_flags + 40] = chip8.m_audio.m_pitch;
+    bytes[image_flags + 41] = chip8.m_audio.m_loaded;
+}
+
+void Rewind::restore(const Image& image, Chip8& chip8) const
+{
+    const auto* bytes = reinterpret_cast<const uint8*>(image.data());
+
+    /* only changed memory is written and re-decoded */
+    constexpr std::size_t block = 64;
+    for(std::size_t addr = 0; addr < Chip8::memory_size; addr += block)
+    {
+        if(std::memcmp(&chip8.m_memory[addr], bytes + addr, block) == 0) continue;
+
+        std::memcpy(&chip8.m_memory[addr], bytes + addr, block);
+        chip8.invalidate(static_cast<uint16>(addr), block);
+    }
+
+    std::memcpy(chip8.m_display.m_planes.data(), bytes + Chip8::memory_size, image_display);
+    chip8.m_display.m_hires = bytes[image_flags + 2] != 0;
+    chip8.m_display.m_mask = bytes[image_flags + 3];
+    chip8.m_display.changed(~uint64(0));
+    std::memcpy(&chip8.m_register, bytes + image_registers, sizeof(Chip8::Registers));
+    std::memcpy(chip8.m_stack.data(), bytes + image_stack, 16 * sizeof(uint16));
+    chip8.m_await_interrupt = bytes[image_flags] != 0;
+    chip8.m_tick_carry = bytes[image_flags + 1];
+    std::memcpy(&chip8.m_random, bytes + image_flags + 4, sizeof(uint32));
+    std::memcpy(chip8.m_flags.data(), bytes + image_flags + 8, 16);
+    std::memcpy(chip8.m_audio.m_pattern.data(), bytes + image_flags + 24, 16);
+    chip8.m_audio.m_pitch = bytes[image_flags + 40];
+    chip8.m_audio.m_loaded = bytes[image_flags + 41] != 0;
+}
+
+std::size_t Rewind::encode(const Image& image, const Image* base)
+{
+    /* runs: [skip words][literal words] followed by the literal words (xor against base) */
+    const auto word = [&](std::size_t w) { return base ? image[w] ^ (*base)[w] : image[w]; };
+
+    uint8* out = m_scratch.data();
+    for(std::size_t w = 0; w < image_words; )
+    {
+        const std::size_t skip = w;
+        while(w < image_words && word(w) == 0) w++;
+        if(w == image_words) break;
+
+        const std::size_t literal = w;
+        while(w < image_words && word(w) != 0) w++;
+
+        detail::put_run(out, static_cast<uint16>(literal - skip), static_cast<uint16>(w - literal));
+        for(std::size_t i = literal; i < w; i++)
+        {
+            const uint64 value = word(i);
+            std::memcpy(out, &value, sizeof(value));
+            out += sizeof(value);
+        }
+    }
+
+    return out - m_scratch.data();
+}
+
+void Rewind::decode(const Entry& entry, Image& image) const
+{
+    const uint8* in = m_ring.data() + entry.m_offset;
+    const uint8* const end = in + entry.m_size;
+
+    std::size_t w = 0;
+    while(in < end)
+    {
+        uint16 skip, count;
+        detail::get_run(in, skip, count);
+
+        w += skip;
+        for(uint16 i = 0; i < count; i++, w++)
+        {
+            uint64 value;
+            std::memcpy(&value, in, sizeof(value));
+            in += sizeof(value);
+            image[w] ^= value;
+        }
+    }
+}
+
+bool Rewind::reserve(std::size_t size, std::size_t& offset)
+{
+    while(true)
+    {
+        if(m_first == m_next)
+        {
+            m_head = 0;
+            offset = 0;
+            return size <= m_ring.size();
+        }
+
+        if(frames() < m_entries.size())
+        {
+            /* records occupy [tail, head) or, wrapped, [tail, end) and [0, head) */
+            const auto tail = entry(m_first).m_offset;
+            if(m_head > tail)
+            {
+                if(m_head + size <= m_ring.size())
+                {
+                    offset = m_head;
+                    return true;
+                }
+                if(size <= tail)
+                {
+                    offset = 0;
+                    return true;
+                }
+            }
+            else if(m_head + size <= tail)
+            {
+                offset = m_head;
+                return true;
+            }
+        }
+
+        drop_group();
+    }
+}
+
+void Rewind::drop_group()
+{
+    /* a keyframe is only dropped together with its deltas */
+    const auto keyframe = entry(m_first).m_keyframe;
+    do
+    {
+        m_first++;
+        m_stats.m_dropped++;
+    }
+    while(m_first < m_next && entry(m_first).m_keyframe == keyframe);
+}
+
+Rewind::Entry& Rewind::entry(uint64 sequence)
+{
+    return m_entries[sequence % m_entries.size()];
+}
+
+const Rewind::Entry& Rewind::entry(uint64 sequence) const
+{
+    return m_entries[sequence % m_entries.size()];
+}
+
+std::ostream& operator<<(std::ostream& stream, const Rewind& rewind)
+{
+    const auto& stats = rewind.stats();
+    const double records = stats.m_records ? double(stats.m_records) : 1.0;
+    const double rewinds = stats.m_rewinds ? double(stats.m_rewinds) : 1.0;
+
+    stream << "rewind: " << rewind.frames() << " frames (" << rewind.frames() / 60.0 << "s), "
+           << rewind.used() / 1024.0 << " / " << rewind.capacity() / 1024.0 << " KiB, "
+           << stats.m_keyframes << " keyframes, " << stats.m_dropped << " dropped\n";
+    stream << "        " << stats.m_bytes / records << " bytes/frame, record " << 1e6 * stats.m_record_time / records
+           << " us/frame (max " << 1e6 * stats.m_record_max << " us), rewind " << 1e6 * stats.m_rewind_time / rewinds << " us/frame\n";
+
+    return stream;
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Rewind Buffer:
+ *  -----------------------------
+ *    -> record() snapshots the machine once per tick, rewind() steps back one recorded tick
+ *    -> a snapshot is an image of memory, display, registers, stack, FX0A wait flag, speed remainder, random generator,
+ *       SUPER-CHIP resolution and user flags and XO-CHIP plane selection and audio
+ *       (settings and keypad are not restored; they belong to the user)
+ *    -> every keyframe_interval ticks the image is stored as keyframe, the ticks in between
+ *       as XOR delta against their keyframe
+ *    -> records are run length encoded (runs of unchanged 8 byte words are skipped)
+ *    -> records live in a fixed size byte ring, the index in a fixed size entry ring;
+ *       both are allocated by the constructor, the oldest keyframe (with its deltas) is dropped when full
+ *
+ *    record() and rewind() do not allocate.
+ *
+ *  -----------------------------
+ */
+struct Rewind
+{
+    /* measured per frame budget */
+    struct Stats
+    {
+        uint64 m_records = 0;           /* record() calls */
+        uint64 m_keyframes = 0;         /* records stored as keyframe */
+        uint64 m_rewinds = 0;           /* rewind() calls that restored a frame */
+        uint64 m_bytes = 0;             /* encoded bytes of all records */
+        uint64 m_dropped = 0;           /* frames dropped to make room */
+        double m_record_time = 0.0;     /* seconds spent in record() */
+        double m_record_max = 0.0;      /* slowest record() */
+        double m_rewind_time = 0.0;     /* seconds spent in rewind() */
+    };
+
+public:
+    /* capacity: bytes of encoded records; frames: maximum number of frames held (default 10 minutes) */
+    explicit Rewind(std::size_t capacity = 4 << 20, std::size_t frames = 60 * 60 * 10, uint32 keyframe_interval = 60);
+
+    /* snapshot of the current state (call after each tick) */
+    void record(const Chip8& chip8);
+
+    /* restore the frame before the newest one and drop the newest (false if there is none) */
+    bool rewind(Chip8& chip8);
+
+    /* drop all frames */
+    void clear();
+
+    /* frames held, bytes of the ring in use and capacity */
+    std::size_t frames() const;
+    std::size_t used() const;
+    std::size_t capacity() const;
+
+    const Stats& stats() const;
+
+private:
+    /* raw image of the restorable state (memory, display planes, registers, stack, wait flag, speed remainder, resolution
+     * and planes, random state, user flags, audio pattern and pitch) */
+    static constexpr std::size_t image_display = sizeof(Chip8::Display::m_planes);
+    static constexpr std::size_t image_registers = Chip8::memory_size + image_display;
+    static constexpr std::size_t image_stack = image_registers + sizeof(Chip8::Registers);
+    static constexpr std::size_t image_flags = image_stack + 16 * sizeof(uint16);
+    static constexpr std::size_t image_words = (image_flags + 8 + 16 + 16 + 2 + 7) / 8;
+    using Image = std::array<uint64, image_words>;
+
+    /* worst case encoding: a run header for every other word plus all words */
+    static constexpr std::size_t max_record = 8 * image_words + 4 * (image_words / 2 + 1);
+
+    struct Entry
+    {
+        std::size_t m_offset = 0;       /* in the byte ring */
+        std::size_t m_size = 0;
+        uint64 m_keyframe = 0;          /* sequence number of the keyframe the delta refers to */
+    };
+
+    void capture(const Chip8& chip8, Image& image) const;
+    void restore(const Image& image, Chip8& chip8) const;
+
+    /* run length encoding of (image ^ base) into m_scratch, returns the size */
+    std::size_t encode(const Image& image, const Image* base);
+    void decode(const Entry& entry, Image& image) const;
+
+    /* place a record of size bytes in the ring (drops the oldest keyframe groups if needed) */
+    bool reserve(std::size_t size, std::size_t& offset);
+    void drop_group();
+
+    Entry& entry(uint64 sequence);
+    const Entry& entry(uint64 sequence) const;
+
+private:
+    std::vector<uint8> m_ring;
+    std::vector<Entry> m_entries;
+    std::vector<uint8> m_scratch;
+    uint32 m_keyframe_interval;
+
+    /* sequence numbers of the oldest and the next frame (entries are indexed by sequence % frames) */
+    uint64 m_first = 0;
+    uint64 m_next = 0;
+    std::size_t m_head = 0;             /* write position in the byte ring */
+
+    /* keyframe of the newest frame (base of the next delta) */
+    Image m_key;
+    uint64 m_key_sequence = 0;
+    bool m_key_valid = false;
+
+    Image m_image;
+
+    Stats m_stats;
+};
+
+/* per frame budget (bytes, record and rewind time) */
+std::ostream& operator<< (std::ostream& stream, const Rewind& rewind);
+
+}
@@ -0,0 +1,438 @@
+#include "chip8.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_STATE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CHIP8_STATE_MMAP 0
+#endif
+
+/*
+ *  Save states:
+ *  -----------------------------
+ *  Binary snapshot of the complete machine state, all values little-endian:
+ *
+ *  +--------+------+---------------------------------------------------------------+
+ *  | offset | size |                                                               |
+ *  +--------+------+---------------------------------------------------------------+
+ *  |      0 |    4 | magic "C8ST"                                                  |
+ *  |      4 |    2 | version (Chip8::state_version)                                |
+ *  |      6 |    2 | reserved (0)                                                  |
+ *  |      8 |   16 | V0 - VF                                                       |
+ *  |     24 |    8 | I, PC, SP (16-bit), delay timer, sound timer (8-bit)          |
+ *  |     32 |   32 | stack (16 x 16-bit)                                           |
+ *  |     64 |    2 | keypad (bit k = key k pressed)                                |
+ *  |     66 |    1 | waiting for key (FX0A)                                        |
+ *  |     67 |    1 | quirks (eQuirk bitmask)                                       |
+ *  |     68 |    4 | cycles per tick                                               |
+ *  |     72 |    4 | speed (instructions per second, 0: cycles per tick)           |
+ *  |     76 |    4 | core (eCore)                                                  |
+ *  |     80 |    4 | random generator state                                        |
+ *  |     84 |    4 | speed remainder carried to the next tick                      |
+ *  |     88 |   16 | SUPER-CHIP user flags (FX75)                                  |
+ *  |    104 |    1 | hires display (00FF)                                          |
+ *  |    105 |    1 | selected planes (XO-CHIP FN01)                                |
+ *  |    106 |    1 | display planes p (1, XO-CHIP 2)                               |
+ *  |    107 |    1 | audio pitch (XO-CHIP FX3A)                                    |
+ *  |    108 |   16 | audio pattern (XO-CHIP F002)                                  |
+ *  |    124 |    4 | audio pattern loaded                                          |
+ *  |    128 |    4 | memory size (0x1000, XO-CHIP 0x10000)                         |
+ *  |    132 |  ... | per plane: row mask (bit y = row y stored, 64-bit) and the    |
+ *  |        |      | non-empty rows (16 bytes: two words, packed, MSB = x 0)       |
+ *  |        |    2 | memory range count                                            |
+ *  |        |  ... | per range: address, size (16-bit), bytes; omitted memory is 0 |
+ *  +--------+------+---------------------------------------------------------------+
+ *
+ *    -> memory ranges are runs of non-zero blocks of memory size / 64 bytes (ascending), so a fresh
+ *       machine with a rom is about the font plus the rom (a range is at most 0xFFFF bytes, longer runs are split)
+ *    -> states only load into a build with the same memory size and plane count
+ *    -> loading compares the restored memory per block and only re-decodes blocks that changed
+ */
+namespace emu
+{
+
+namespace detail
+{
+
+constexpr uint8 state_magic[4] = { 'C', '8', 'S', 'T' };
+constexpr std::size_t state_header = 132;
+constexpr std::size_t state_block = Chip8::memory_size / 64;
+constexpr std::size_t state_blocks = Chip8::memory_size / state_block;
+constexpr std::size_t state_range_blocks = 0xFFFF / state_block;
+static_assert(state_blocks == 64);
+
+/* worst case: all of memory plus a range header for every other block */
+constexpr std::size_t state_max_size = state_header + 8 * Chip8::Display::plane_count + sizeof(Chip8::Display::m_planes) + 2
+                                     + Chip8::memory_size + (state_blocks / 2 + 1) * 4;
+
+void put16(uint8*& out, uint16 v) { out[0] = v; out[1] = v >> 8; out += 2; }
+void put32(uint8*& out, uint32 v) { for(int i = 0; i < 4; i++) out[i] = v >> (8 * i); out += 4; }
+void put64(uint8*& out, uint64 v) { for(int i = 0; i < 8; i++) out[i] = v >> (8 * i); out += 8; }
+
+uint16 get16(const uint8*& in) { uint16 v = in[0] | in[1] << 8; in += 2; return v; }
+uint32 get32(const uint8*& in) { uint32 v = 0; for(int i = 0; i < 4; i++) v |= uint32(in[i]) << (8 * i); in += 4; return v; }
+uint64 get64(const uint8*& in) { uint64 v = 0; for(int i = 0; i < 8; i++) v |= uint64(in[i]) << (8 * i); in += 8; return v; }
+
+/* bit b set: memory block b has a non-zero byte (or-reduction per block, vectorizes) */
+uint64 used_blocks(const Chip8::Memory& memory)
+{
+    uint64 used = 0;
+    for(std::size_t b = 0; b < state_blocks; b++)
+    {
+        uint64 bits = 0;
+        for(std::size_t i = 0; i < state_block; i += sizeof(uint64))
+        {
+            uint64 word;
+            std::memcpy(&word, &memory[b * state_block + i], sizeof(word));
+            bits |= word;
+        }
+        used |= uint64(bits != 0) << b;
+    }
+
+    return used;
+}
+
+/* first block >= from whose bit equals value (state_blocks if none) */
+std::size_t find_block(uint64 used, std::size_t from, bool value)
+{
+    if(from >= state_blocks) return state_blocks;
+
+    const uint64 bits = (value ? used : ~used) & (~uint64(0) << from);
+    return bits ? std::countr_zero(bits) : state_blocks;
+}
+
+/* true if memory[addr, addr + size) is all zero */
+bool zero(const Chip8::Memory& memory, std::size_t addr, std::size_t size)
+{
+    uint8 bits = 0;
+    for(std::size_t i = addr; i < addr + size; i++) bits |= memory[i];
+    return bits == 0;
+}
+
+}
+
+void Chip8::save_state(std::vector<uint8>& state) const
+{
+    /* grows once to the worst case size; later calls reuse the capacity */
+    state.resize(detail::state_max_size);
+    uint8* out = state.data();
+
+    std::copy(std::begin(detail::state_magic), std::end(detail::state_magic), out);
+    out += 4;
+    detail::put16(out, state_version);
+    detail::put16(out, 0);
+
+    /* registers */
+    std::copy(m_register.V.begin(), m_register.V.end(), out);
+    out += 16;
+    detail::put16(out, m_register.I);
+    detail::put16(out, m_register.PC);
+    detail::put16(out, m_register.SP);
+    *out++ = m_register.timer_delay;
+    *out++ = m_register.timer_sound;
+    for(auto addr : m_stack) detail::put16(out, addr);
+
+    /* keypad, settings and generator */
+    uint16 keys = 0;
+    for(int k = 0; k < eKey::COUNT; k++) keys |= m_keypad[k] << k;
+    detail::put16(out, keys);
+    *out++ = m_await_interrupt;
+    *out++ = m_settings.quirks();
+    detail::put32(out, static_cast<uint32>(m_settings.m_cycles));
+    detail::put32(out, static_cast<uint32>(m_settings.m_speed));
+    detail::put32(out, static_cast<uint32>(m_settings.m_core));
+    detail::put32(out, m_random);
+    detail::put32(out, m_tick_carry);
+    std::copy(m_flags.begin(), m_flags.end(), out);
+    out += 16;
+    *out++ = m_display.m_hires;
+    *out++ = m_display.m_mask;
+    *out++ = Display::plane_count;
+    *out++ = m_audio.m_pitch;
+    std::copy(m_audio.m_pattern.begin(), m_audio.m_pattern.end(), out);
+    out += 16;
+    detail::put32(out, m_audio.m_loaded);
+    detail::put32(out, memory_size);
+
+    /* display (empty rows are skipped) */
+    for(const auto& plane : m_display.m_planes)
+    {
+        uint8* mask = out;
+        out += 8;
+        uint64 rows = 0;
+        for(int y = 0; y < max_height_res; y++)
+        {
+            const auto left = plane[0][y];
+            const auto right = plane[1][y];
+            if((left | right) == 0) continue;
+
+            rows |= uint64(1) << y;
+            detail::put64(out, left);
+            detail::put64(out, right);
+        }
+        detail::put64(mask, rows);
+    }
+
+    /* memory (runs of non-empty blocks, found on a bitmask of the blocks) */
+    const auto used = detail::used_blocks(m_memory);
+    uint8* count = out;
+    out += 2;
+    uint16 ranges = 0;
+    for(std::size_t block = detail::find_block(used, 0, true); block < detail::state_blocks; )
+    {
+        const std::size_t last = std::min(detail::find_block(used, block, false), block + detail::state_range_blocks);
+        const std::size_t addr = block * detail::state_block;
+        const std::size_t size = (last - block) * detail::state_block;
+
+        detail::put16(out, static_cast<uint16>(addr));
+        detail::put16(out, static_cast<uint16>(size));
+        std::memcpy(out, &m_memory[addr], size);
+        out += size;
+
+        ranges++;
+        block = detail::find_block(used, last, true);
+    }
+    detail::put16(count, ranges);
+
+    state.resize(out - state.data());
+}
+
+std::vector<uint8> Chip8::save_state() const
+{
+    std::vector<uint8> state;
+    save_state(state);
+    return state;
+}
+
+bool Chip8::save_state(const std::filesystem::path& path) const
+{
+    const auto state = save_state();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(state.data()), state.size());
+    if(!file)
+    {
+        std::cerr << "[Chip8::save_state] Couldn't write " + path.string() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Chip8::load_state(const uint8* data, std::size_t size)
+{
+    const uint8* in = data;
+    const uint8* const end = data + size;
+
+    /* validate header and fixed part before touching any state */
+    if(size < detail::state_header + 8 * Display::plane_count + 2 || !std::equal(std::begin(detail::state_magic), std::end(detail::state_magic), in))
+    {
+        std::cerr << "[Chip8::load_state] Not a chip-8 save state!" << std::endl;
+        return false;
+    }
+    in += 4;
+
+    if(detail::get16(in) != state_version)
+    {
+        std::cerr << "[Chip8::load_state] Unsupported save state version!" << std::endl;
+        return false;
+    }
+    in += 2;
+
+    Registers regs;
+    std::copy(in, in + 16, regs.V.begin());
+    in += 16;
+    regs.I = detail::get16(in);
+    regs.PC = detail::get16(in);
+    regs.SP = detail::get16(in);
+    regs.timer_delay = *in++;
+    regs.timer_sound = *in++;
+
+    std::array<uint16, 16> stack;
+    for(auto& addr : stack) addr = detail::get16(in);
+
+    const uint16 keys = detail::get16(in);
+    const bool await_interrupt = *in++ != 0;
+    const uint8 quirks = *in++;
+    const auto cycles = static_cast<int>(detail::get32(in));
+    const auto speed = static_cast<int>(detail::get32(in));
+    const auto core = detail::get32(in);
+    const uint32 random = detail::get32(in);
+    const uint32 carry = detail::get32(in);
+
+    std::array<uint8, 16> flags;
+    std::copy(in, in + 16, flags.begin());
+    in += 16;
+    const bool hires = (*in++ & 0x1) != 0;
+    const uint8 planes = *in++;
+    const uint8 plane_count = *in++;
+
+    Audio audio;
+    audio.m_pitch = *in++;
+    std::copy(in, in + 16, audio.m_pattern.begin());
+    in += 16;
+    audio.m_loaded = (detail::get32(in) & 0x1) != 0;
+    const uint32 memory_bytes = detail::get32(in);
+
+    if(memory_bytes != memory_size || plane_count != Display::plane_count)
+    {
+        std::cerr << "[Chip8::load_state] Save state of a " << (memory_bytes == 0x10000 ? "XO-CHIP" : "chip-8") << " build!" << std::endl;
+        return false;
+    }
+
+    if(regs.PC >= memory_size || regs.SP > stack.size() || core > CORE_AOT || carry >= tick_rate)
+    {
+        std::cerr << "[Chip8::load_state] Corrupt save state!" << std::endl;
+        return false;
+    }
+
+    /* display */
+    Display display;
+    for(int p = 0; p < Display::plane_count; p++)
+    {
+        /* the size check above covers the first row mask, each plane checks for the next one */
+        auto& plane = display.m_planes[p];
+        const uint64 rows = detail::get64(in);
+        if(std::size_t(end - in) < 16 * std::size_t(std::popcount(rows)) + 8 * std::size_t(Display::plane_count - 1 - p) + 2)
+        {
+            std::cerr << "[Chip8::load_state] Truncated save state!" << std::endl;
+            return false;
+        }
+        for(int y = 0; y < max_height_res; y++)
+        {
+            plane[0][y] = (rows >> y) & 0x1 ? detail::get64(in) : 0;
+            plane[1][y] = (rows >> y) & 0x1 ? detail::get64(in) : 0;
+        }
+    }
+
+    /* memory ranges (block aligned, ascending and in bounds) */
+    const uint16 ranges = detail::get16(in);
+    const uint8* const memory = in;
+    std::size_t cursor = 0;
+    for(uint16 r = 0; r < ranges; r++)
+    {
+        if(end - in < 4)
+        {
+            std::cerr << "[Chip8::load_state] Truncated save state!" << std::endl;
+            return false;
+        }
+
+        const uint16 addr = detail::get16(in);
+        const uint16 length = detail::get16(in);
+        if(addr % detail::state_block || length % detail::state_block || addr < cursor ||
+           std::size_t(addr) + length > memory_size || std::size_t(end - in) < length)
+        {
+            std::cerr << "[Chip8::load_state] Corrupt save state!" << std::endl;
+            return false;
+        }
+
+        in += length;
+        cursor = addr + length;
+    }
+
+    /* commit */
+    m_register = regs;
+    m_stack = stack;
+    m_display.m_planes = display.m_planes;
+    m_display.m_hires = hires;
+    m_display.m_mask = planes & 0x3;
+    m_audio = audio;
+    m_display.changed(~uint64(0));
+    m_flags = flags;
+    for(int k = 0; k < eKey::COUNT; k++) m_keypad[k] = (keys >> k) & 0x1;
+    m_await_interrupt = await_interrupt;
+    m_random = random;
+    m_tick_carry = static_cast<uint8>(carry);
+
+    m_settings.m_vf_reset = quirks & QUIRK_VF_RESET;
+    m_settings.m_memory = quirks & QUIRK_MEMORY;
+    m_settings.m_shifting = quirks & QUIRK_SHIFTING;
+    m_settings.m_jumping = quirks & QUIRK_JUMPING;
+    m_settings.m_cycles = cycles;
+    m_settings.m_speed = speed;
+    m_settings.m_core = static_cast<eCore>(core);
+
+    /* only blocks that differ are written and re-decoded (which also drops their jit blocks) */
+    const auto restore = [this](std::size_t addr, const uint8* block)
+    {
+        if(block ? std::memcmp(&m_memory[addr], block, detail::state_block) == 0 : detail::zero(m_memory, addr, detail::state_block)) return;
+
+        if(block) std::memcpy(&m_memory[addr], block, detail::state_block);
+        else std::memset(&m_memory[addr], 0, detail::state_block);
+        invalidate(static_cast<uint16>(addr), detail::state_block);
+    };
+
+    in = memory;
+    cursor = 0;
+    for(uint16 r = 0; r < ranges; r++)
+    {
+        const uint16 addr = detail::get16(in);
+        const uint16 length = detail::get16(in);
+
+        for(; cursor < addr; cursor += detail::state_block) restore(cursor, nullptr);
+        for(; cursor < std::size_t(addr) + length; cursor += detail::state_block, in += detail::state_block) restore(cursor, in);
+    }
+    for(; cursor < memory_size; cursor += detail::state_block) restore(cursor, nullptr);
+
+    select_quirks();
+    return true;
+}
+
+bool Chip8::load_state(const std::vector<uint8>& state)
+{
+    return load_state(state.data(), state.size());
+}
+
+bool Chip8::load_state(const std::filesystem::path& path)
+{
+#if CHIP8_STATE_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        std::cerr << "[Chip8::load_state] State " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        std::cerr << "[Chip8::load_state] Couldn't read " + path.string() << std::endl;
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        std::cerr << "[Chip8::load_state] Couldn't map " + path.string() << std::endl;
+        return false;
+    }
+
+    const bool loaded = load_state(static_cast<const uint8*>(data), info.st_size);
+    munmap(data, info.st_size);
+    return loaded;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "[Chip8::load_state] State " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    std::vector<uint8> state(std::istreambuf_iterator<char>(file), {});
+    return load_state(state);
+#endif
+}
+
+}
@@ -0,0 +1,83 @@
+#include "synth.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace emu
+{
+
+namespace detail
+{
+
+/* chip-8 tone: half a period high, half low */
+constexpr std::array<uint8, 16> square = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                           0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+inline bool pattern_bit(const std::array<uint8, 16>& pattern, int bit)
+{
+    return (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+}
+
+void Synth::tick(const Chip8& chip8, Block& block)
+{
+    const auto& audio = chip8.audio();
+    const bool loaded = Chip8::xo_chip && audio.m_loaded;
+    const auto& pattern = loaded ? audio.m_pattern : detail::square;
+    const double step = (loaded ? audio.rate() : m_tone * 128.0) / sample_rate;    /* pattern bits per sample */
+    const double high = m_volume;
+
+    /* buzzer on/off: the edge lies on the tick boundary, the first sample is half way */
+    const bool on = chip8.buzzer();
+    if(on != m_on)
+    {
+        m_phase = 0.0;
+        const double level = on && detail::pattern_bit(pattern, 0) ? high : 0.0;
+        m_carry -= (level - m_level) * 0.5;
+        m_level = level;
+        m_on = on;
+    }
+
+    if(!m_on)
+    {
+        block.fill(0);
+        block[0] = static_cast<int16>(std::lround(m_carry));
+        m_carry = 0.0;
+        return;
+    }
+
+    for(auto& sample : block)
+    {
+        double value = m_level + m_carry;
+        m_carry = 0.0;
+
+        /* pattern edges between this sample and the next one, at d (0, 1] samples after this one */
+        const double end = m_phase + step;
+        for(double edge = std::floor(m_phase) + 1.0; edge <= end; edge += 1.0)
+        {
+            const double level = detail::pattern_bit(pattern, static_cast<int>(edge) & 127) ? high : 0.0;
+            if(level == m_level) continue;
+
+            /* PolyBLEP: (1 - d)^2 / 2 of the step before the edge, -d^2 / 2 after it */
+            const double d = (edge - m_phase) / step;
+            const double h = level - m_level;
+            value += h * (1.0 - d) * (1.0 - d) * 0.5;
+            m_carry -= h * d * d * 0.5;
+            m_level = level;
+        }
+        m_phase = std::fmod(end, 128.0);
+
+        sample = static_cast<int16>(std::clamp(std::lround(value), -32768l, 32767l));
+    }
+}
+
+void Synth::reset()
+{
+    m_phase = 0.0;
+    m_level = 0.0;
+    m_carry = 0.0;
+    m_on = false;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <array>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Synth:
+ *  -----------------------------
+ *    -> renders the buzzer one tick at a time: samples_per_tick mono 16-bit samples at sample_rate
+ *    -> a tick sounds if the sound timer ran during it (Chip8::buzzer()), so the tone starts and stops
+ *       exactly on the tick boundaries
+ *    -> chip-8: square wave of m_tone hz; XO-CHIP: the loaded pattern at Audio::rate() bits per second
+ *       (both are a looping 128 bit pattern, the square wave is 64 set bits followed by 64 cleared ones)
+ *    -> a set bit is m_volume, a cleared bit and the silent buzzer are 0 (an all-zero XO-CHIP pattern is silent)
+ *    -> every level change (pattern edges, buzzer on/off) is band-limited with PolyBLEP: a two sample polynomial
+ *       residual placed at the exact position of the edge between the samples, so high pitches do not alias
+ *
+ *    The pattern restarts when the buzzer turns on, the output only depends on the ticks rendered
+ *    (deterministic, independent of the host).
+ *
+ *  -----------------------------
+ */
+struct Synth
+{
+    static constexpr int sample_rate = 48000;
+    static constexpr int samples_per_tick = sample_rate / Chip8::tick_rate;
+    static_assert(sample_rate % Chip8::tick_rate == 0, "a tick has to be a whole number of samples");
+
+    using Block = std::array<int16, samples_per_tick>;
+
+    /* square wave frequency (chip-8, or XO-CHIP before F002) and peak amplitude */
+    double m_tone = 440.0;
+    int16 m_volume = 8192;
+
+public:
+    /* render the tick chip8 just ran (call after every tick, in order) */
+    void tick(const Chip8& chip8, Block& block);
+
+    /* silence, pattern restarts (e.g. after loading a state) */
+    void reset();
+
+private:
+    /* position in the 128 bit pattern, naive level of the current sample, PolyBLEP residual of the next sample */
+    double m_phase = 0.0;
+    double m_level = 0.0;
+    double m_carry = 0.0;
+    bool m_on = false;
+};
+
+}
@@ -0,0 +1,543 @@
+#include "chip8.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+/*
+ *  Threaded code interpreter core:
+ *  -----------------------------
+ *    -> runs a whole budget of instructions in one function
+ *    -> instantiated per quirk combination (no runtime quirk checks)
+ *    -> dispatches on the predecoded eCode of the cache entry
+ *         - GCC/Clang: labels as values (one indirect jump per handler, no call/return)
+ *         - otherwise: portable switch in a loop
+ *    -> V, I, PC, SP are held in locals and written back on exit
+ *    -> while tracing, a second instantiation records each instruction when the next one is fetched
+ *
+ *    Produces results identical to the table interpreter (Chip8::execute_cycle).
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO 1
+#else
+#define CHIP8_COMPUTED_GOTO 0
+#endif
+
+namespace emu
+{
+
+int Chip8::execute_threaded(int cycles)
+{
+    /* one instantiation per quirk combination (and one recording a trace) */
+    static const auto cores = []<std::size_t... Q>(std::index_sequence<Q...>)
+    {
+        return std::array<int (Chip8::*)(int), quirk_count>{ &Chip8::run_threaded<Q, false>... };
+    }(std::make_index_sequence<quirk_count>());
+
+    static const auto traced = []<std::size_t... Q>(std::index_sequence<Q...>)
+    {
+        return std::array<int (Chip8::*)(int), quirk_count>{ &Chip8::run_threaded<Q, true>... };
+    }(std::make_index_sequence<quirk_count>());
+
+    return (this->*(m_trace ? traced : cores)[m_quirks])(cycles);
+}
+
+template<uint8 Quirks, bool Traced>
+int Chip8::run_threaded(int cycles)
+{
+    using detail::eCode;
+
+    auto V = m_register.V;
+    uint16 I = m_register.I;
+    uint16 PC = m_register.PC;
+    uint16 SP = m_register.SP;
+
+    Instruction::Decoded decoded;
+
+    /* tracing: the last fetched instruction, recorded once it executed (only run() calls this, the first
+     * instruction is the first one of its budget) */
+    uint64 cycle = m_instruction_count - cycles;
+    uint16 traced_pc = 0;
+    uint16 traced_op = 0;
+    auto traced_V = V;
+    bool pending = false;
+
+#define RECORD()                                                                        \
+    if constexpr(Traced) if(pending)                                                    \
+    {                                                                                   \
+        m_trace->record(cycle++, traced_pc, traced_op, I, traced_V, V);                 \
+        pending = false;                                                                \
+    }
+
+#define FETCH()                                                                         \
+    RECORD();                                                                           \
+    if(cycles-- <= 0) goto done;                                                        \
+    decoded = (PC & 0x1) ? m_instructions.predecode(m_memory[PC & memory_mask] << 8 |   \
+                                                    m_memory[(PC + 1) & memory_mask])   \
+                         : m_decoded[(PC & memory_mask) >> 1];                          \
+    if constexpr(profiling) m_profile->count(PC, decoded);                              \
+    if constexpr(Traced)                                                                \
+    {                                                                                   \
+        traced_pc = PC;                                                                 \
+        traced_op = decoded.m_op_code.data();                                          \
+        traced_V = V;                                                                   \
+        pending = true;                                                                 \
+    }
+
+#define OP decoded.m_op_code
+
+#if CHIP8_COMPUTED_GOTO
+    static const void* labels[eCode::UNKOWN + 1] =
+    {
+        &&L_00E0, &&L_00EE,
+        &&L_1NNN, &&L_2NNN, &&L_3XNN, &&L_4XNN, &&L_5XY0, &&L_6XNN, &&L_7XNN,
+        &&L_8XY0, &&L_8XY1, &&L_8XY2, &&L_8XY3, &&L_8XY4, &&L_8XY5, &&L_8XY6, &&L_8XY7, &&L_8XYE,
+        &&L_9XY0,
+        &&L_ANNN, &&L_BNNN, &&L_CXNN, &&L_DXYN,
+        &&L_EX9E, &&L_EXA1,
+        &&L_FX07, &&L_FX0A, &&L_FX15, &&L_FX18, &&L_FX1E, &&L_FX29, &&L_FX33, &&L_FX55, &&L_FX65,
+        &&L_00CN, &&L_00FB, &&L_00FC, &&L_00FD, &&L_00FE, &&L_00FF, &&L_FX30, &&L_FX75, &&L_FX85,
+        &&L_00DN, &&L_5XY2, &&L_5XY3, &&L_F000, &&L_FN01, &&L_F002, &&L_FX3A,
+        &&LUNKOWN
+    };
+
+#define CASE(code) L##code:
+#define NEXT(delta) do { PC += (delta); FETCH(); goto *labels[decoded.m_code]; } while(0)
+#define BEGIN_DISPATCH() FETCH(); goto *labels[decoded.m_code];
+#define END_DISPATCH()
+#else
+#define CASE(code) case eCode::code:
+#define NEXT(delta) { PC += (delta); continue; }
+#define BEGIN_DISPATCH() for(;;) { FETCH(); switch(decoded.m_code) {
+#define END_DISPATCH() } }
+#endif
+
+    BEGIN_DISPATCH()
+
+    CASE(_00E0)
+    {
+        m_display.clear();
+        NEXT(2);
+    }
+
+    CASE(_00EE)
+    {
+        SP--;
+        PC = m_stack[SP];
+        NEXT(2);
+    }
+
+    CASE(_1NNN)
+    {
+        PC = OP.nnn();
+        NEXT(0);
+    }
+
+    CASE(_2NNN)
+    {
+        m_stack[SP] = PC;
+        SP++;
+        PC = OP.nnn();
+        NEXT(0);
+    }
+
+    CASE(_3XNN)
+    {
+        NEXT(2 + skip_size(PC) * (V[OP.x()] == OP.nn()));
+    }
+
+    CASE(_4XNN)
+    {
+        NEXT(2 + skip_size(PC) * (V[OP.x()] != OP.nn()));
+    }
+
+    CASE(_5XY0)
+    {
+        NEXT(2 + skip_size(PC) * (V[OP.x()] == V[OP.y()]));
+    }
+
+    CASE(_6XNN)
+    {
+        V[OP.x()] = OP.nn();
+        NEXT(2);
+    }
+
+    CASE(_7XNN)
+    {
+        V[OP.x()] += OP.nn();
+        NEXT(2);
+    }
+
+    CASE(_8XY0)
+    {
+        V[OP.x()] = V[OP.y()];
+        NEXT(2);
+    }
+
+    CASE(_8XY1)
+    {
+        V[OP.x()] |= V[OP.y()];
+        if constexpr(Quirks & QUIRK_VF_RESET) V[0xF] = 0;
+        NEXT(2);
+    }
+
+    CASE(_8XY2)
+    {
+        V[OP.x()] &= V[OP.y()];
+        if constexpr(Quirks & QUIRK_VF_RESET) V[0xF] = 0;
+        NEXT(2);
+    }
+
+    CASE(_8XY3)
+    {
+        V[OP.x()] ^= V[OP.y()];
+        if constexpr(Quirks & QUIRK_VF_RESET) V[0xF] = 0;
+        NEXT(2);
+    }
+
+    CASE(_8XY4)
+    {
+        auto& vx = V[OP.x()];
+        auto& vy = V[OP.y()];
+        V[0xF] = vy > (0xFF - vx);
+
+        vx += vy;
+        NEXT(2);
+    }
+
+    CASE(_8XY5)
+    {
+        auto& vx = V[OP.x()];
+        auto& vy = V[OP.y()];
+        V[0xF] = !(vy >= vx);
+
+        vx -= vy;
+        NEXT(2);
+    }
+
+    CASE(_8XY6)
+    {
+        auto& vx = V[OP.x()];
+        if constexpr(Quirks & QUIRK_SHIFTING)
+        {
+            V[0xF] = vx & 0x1;
+            vx >>= 1;
+        }
+        else
+        {
+            auto& vy = V[OP.y()];
+            V[0xF] = vy & 0x1;
+            vx = vy >> 1;
+        }
+        NEXT(2);
+    }
+
+    CASE(_8XY7)
+    {
+        auto& vx = V[OP.x()];
+        auto& vy = V[OP.y()];
+        V[0xF] = vx <= vy;
+
+        vx = vy - vx;
+        NEXT(2);
+    }
+
+    CASE(_8XYE)
+    {
+        auto& vx = V[OP.x()];
+        if constexpr(Quirks & QUIRK_SHIFTING)
+        {
+            V[0xF] = vx >> 7;
+            vx <<= 1;
+        }
+        else
+        {
+            auto& vy = V[OP.y()];
+            V[0xF] = vy >> 7;
+            vx = vy << 1;
+        }
+        NEXT(2);
+    }
+
+    CASE(_9XY0)
+    {
+        NEXT(2 + skip_size(PC) * (V[OP.x()] != V[OP.y()]));
+    }
+
+    CASE(_ANNN)
+    {
+        I = OP.nnn();
+        NEXT(2);
+    }
+
+    CASE(_BNNN)
+    {
+        if constexpr(Quirks & QUIRK_JUMPING) PC = V[OP.x()] + OP.nnn();
+        else PC = V[0] + OP.nnn();
+        NEXT(0);
+    }
+
+    CASE(_CXNN)
+    {
+        V[OP.x()] = (random() % 0xFF) & OP.nn();
+        NEXT(2);
+    }
+
+    CASE(_EX9E)
+    {
+        NEXT(2 + skip_size(PC) * m_keypad[ V[OP.x()] ]);
+    }
+
+    CASE(_EXA1)
+    {
+        NEXT(2 + skip_size(PC) * !m_keypad[ V[OP.x()] ]);
+    }
+
+    CASE(_FX07)
+    {
+        V[OP.x()] = m_register.timer_delay;
+        NEXT(2);
+    }
+
+    CASE(_FX15)
+    {
+        m_register.timer_delay = V[OP.x()];
+        NEXT(2);
+    }
+
+    CASE(_FX18)
+    {
+        m_register.timer_sound = V[OP.x()];
+        NEXT(2);
+    }
+
+    CASE(_FX1E)
+    {
+        I += V[OP.x()];
+        NEXT(2);
+    }
+
+    CASE(_FX29)
+    {
+        I = V[OP.x()] * 0x5;
+        NEXT(2);
+    }
+
+    CASE(_FX33)
+    {
+        const auto vx = V[OP.x()];
+
+        m_memory[ (I + 0) & memory_mask ] = vx / 100;
+        m_memory[ (I + 1) & memory_mask ] = (vx / 10) % 10;
+        m_memory[ (I + 2) & memory_mask ] = (vx % 100) % 10;
+        invalidate(I, 3);
+        NEXT(2);
+    }
+
+    CASE(_FX55)
+    {
+        const auto x = OP.x();
+
+        for(int i = 0; i <= x; i++)
+        {
+            m_memory[ (I + i) & memory_mask ] = V[i];
+        }
+        invalidate(I, x + 1);
+
+        if constexpr(Quirks & QUIRK_MEMORY) I += x + 1;
+        NEXT(2);
+    }
+
+    CASE(_FX65)
+    {
+        const auto x = OP.x();
+
+        for(int i = 0; i <= x; i++)
+        {
+            V[i] = m_memory[ (I + i) & memory_mask ];
+        }
+
+        if constexpr(Quirks & QUIRK_MEMORY) I += x + 1;
+        NEXT(2);
+    }
+
+    CASE(_FX0A)
+    {
+        m_await_interrupt = true;
+
+        for(unsigned int i = 0; i < m_keypad.size(); i++)
+        {
+            if(m_keypad[i])
+            {
+                V[OP.x()] = i;
+                m_await_interrupt = false;
+            }
+        }
+
+        /* no key: the rest of the budget would re-execute FX0A */
+        if(m_await_interrupt) goto done;
+        NEXT(2);
+    }
+
+    /* SUPER-CHIP */
+    CASE(_00CN)
+    {
+        m_display.scroll_down(OP.n());
+        NEXT(2);
+    }
+
+    CASE(_00FB)
+    {
+        m_display.scroll_right(4);
+        NEXT(2);
+    }
+
+    CASE(_00FC)
+    {
+        m_display.scroll_left(4);
+        NEXT(2);
+    }
+
+    CASE(_00FD)
+    {
+        NEXT(0);
+    }
+
+    CASE(_00FE)
+    {
+        m_display.resolution(false);
+        NEXT(2);
+    }
+
+    CASE(_00FF)
+    {
+        m_display.resolution(true);
+        NEXT(2);
+    }
+
+    CASE(_FX30)
+    {
+        I = big_font_addr + (V[OP.x()] & 0xF) * 10;
+        NEXT(2);
+    }
+
+    CASE(_FX75)
+    {
+        for(int i = 0; i <= OP.x(); i++)
+        {
+            m_flags[i] = V[i];
+        }
+        NEXT(2);
+    }
+
+    CASE(_FX85)
+    {
+        for(int i = 0; i <= OP.x(); i++)
+        {
+            V[i] = m_flags[i];
+        }
+        NEXT(2);
+    }
+
+    /* XO-CHIP */
+    CASE(_00DN)
+    {
+        m_display.scroll_up(OP.n());
+        NEXT(2);
+    }
+
+    CASE(_5XY2)
+    {
+        const int x = OP.x();
+        const int step = x <= OP.y() ? 1 : -1;
+        const int count = (OP.y() - x) * step + 1;
+
+        for(int i = 0; i < count; i++)
+        {
+            m_memory[ (I + i) & memory_mask ] = V[x + i * step];
+        }
+        invalidate(I, count);
+        NEXT(2);
+    }
+
+    CASE(_5XY3)
+    {
+        const int x = OP.x();
+        const int step = x <= OP.y() ? 1 : -1;
+        const int count = (OP.y() - x) * step + 1;
+
+        for(int i = 0; i < count; i++)
+        {
+            V[x + i * step] = m_memory[ (I + i) & memory_mask ];
+        }
+        NEXT(2);
+    }
+
+    CASE(_F000)
+    {
+        const uint16 addr = PC + 2;
+        I = m_memory[addr] << 8 | m_memory[uint16(addr + 1)];
+        NEXT(4);
+    }
+
+    CASE(_FN01)
+    {
+        m_display.m_mask = OP.x() & 0x3;
+        NEXT(2);
+    }
+
+    CASE(_F002)
+    {
+        for(std::size_t i = 0; i < m_audio.m_pattern.size(); i++)
+        {
+            m_audio.m_pattern[i] = m_memory[ (I + i) & memory_mask ];
+        }
+        m_audio.m_loaded = true;
+        NEXT(2);
+    }
+
+    CASE(_FX3A)
+    {
+        m_audio.m_pitch = V[OP.x()];
+        NEXT(2);
+    }
+
+    CASE(UNKOWN)
+    {
+        /* table handler asserts and stalls (touches no state) */
+        NEXT(decoded.m_exec(*this, decoded.m_op_code));
+    }
+
+    CASE(_DXYN)
+    {
+        const auto vx = V[OP.x()];
+        const auto vy = V[OP.y()];
+
+        V[0xF] = draw_sprite(vx, vy, I, OP.n());
+        NEXT(2);
+    }
+
+    END_DISPATCH()
+
+done:
+    /* FX0A started waiting */
+    RECORD();
+
+    m_register.V = V;
+    m_register.I = I;
+    m_register.PC = PC;
+    m_register.SP = SP;
+
+    /* the budget check leaves -1 once exhausted */
+    return std::max(cycles, 0);
+
+#undef RECORD
+#undef FETCH
+#undef OP
+#undef CASE
+#undef NEXT
+#undef BEGIN_DISPATCH
+#undef END_DISPATCH
+}
+
+}
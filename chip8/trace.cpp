@@ -0,0 +1,194 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_TRACE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define CHIP8_TRACE_MMAP 0
+#endif
+
+namespace emu
+{
+
+namespace detail
+{
+
+constexpr char trace_magic[4] = { 'C', '8', 'T', 'R' };
+
+void trace_header(Trace::Header& header, uint64 capacity)
+{
+    std::memcpy(header.m_magic, trace_magic, 4);
+    header.m_version = Trace::version;
+    header.m_record_size = sizeof(Trace::Record);
+    header.m_reserved = 0;
+    header.m_capacity = capacity;
+    header.m_head = 0;
+}
+
+}
+
+
+Trace::Trace(std::size_t capacity)
+{
+    capacity = std::bit_ceil(std::max<std::size_t>(capacity, 1));
+    m_memory.resize(sizeof(Header) + capacity * sizeof(Record), 0);
+    m_header = reinterpret_cast<Header*>(m_memory.data());
+    m_records = reinterpret_cast<Record*>(m_memory.data() + sizeof(Header));
+    m_mask = capacity - 1;
+
+    detail::trace_header(*m_header, capacity);
+}
+
+Trace::Trace(const std::filesystem::path& path, std::size_t capacity)
+{
+    capacity = std::bit_ceil(std::max<std::size_t>(capacity, 1));
+    const std::size_t size = sizeof(Header) + capacity * sizeof(Record);
+    m_mask = capacity - 1;
+
+#if CHIP8_TRACE_MMAP
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, size) != 0)
+    {
+        if(fd >= 0) close(fd);
+        std::cerr << "[Trace::Trace] Couldn't create " + path.string() << std::endl;
+        return;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        std::cerr << "[Trace::Trace] Couldn't map " + path.string() << std::endl;
+        return;
+    }
+
+    m_mapping = data;
+    m_mapping_size = size;
+    m_header = static_cast<Header*>(data);
+    m_records = reinterpret_cast<Record*>(static_cast<uint8*>(data) + sizeof(Header));
+#else
+    m_memory.resize(size, 0);
+    m_header = reinterpret_cast<Header*>(m_memory.data());
+    m_records = reinterpret_cast<Record*>(m_memory.data() + sizeof(Header));
+    m_path = path;
+#endif
+
+    detail::trace_header(*m_header, capacity);
+}
+
+Trace::~Trace()
+{
+#if CHIP8_TRACE_MMAP
+    if(m_mapping) munmap(m_mapping, m_mapping_size);
+#endif
+
+    if(!m_path.empty() && m_header) save(m_path);
+}
+
+bool Trace::valid() const
+{
+    return m_header != nullptr;
+}
+
+std::size_t Trace::size() const
+{
+    return m_header ? static_cast<std::size_t>(std::min(m_header->m_head, m_mask + 1)) : 0;
+}
+
+uint64 Trace::recorded() const
+{
+    return m_header ? m_header->m_head : 0;
+}
+
+std::size_t Trace::capacity() const
+{
+    return m_header ? static_cast<std::size_t>(m_mask + 1) : 0;
+}
+
+std::vector<Trace::Record> Trace::records() const
+{
+    std::vector<Record> records(size());
+
+    const uint64 first = recorded() - records.size();
+    for(std::size_t i = 0; i < records.size(); i++) records[i] = m_records[(first + i) & m_mask];
+
+    return records;
+}
+
+bool Trace::save(const std::filesystem::path& path) const
+{
+    if(!m_header) return false;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(m_header), sizeof(Header));
+    file.write(reinterpret_cast<const char*>(m_records), capacity() * sizeof(Record));
+
+    return bool(file);
+}
+
+bool Trace::load(const std::filesystem::path& path, std::vector<Record>& records)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "[Trace::load] Trace " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    Header header;
+    if(!file.read(reinterpret_cast<char*>(&header), sizeof(Header)) || std::memcmp(header.m_magic, detail::trace_magic, 4) != 0 ||
+       header.m_version != version || header.m_record_size != sizeof(Record) || !std::has_single_bit(header.m_capacity))
+    {
+        std::cerr << "[Trace::load] " + path.string() + " is no trace of this version!" << std::endl;
+        return false;
+    }
+
+    /* the header's capacity has to match the file (a truncated or damaged file must not size the allocation) */
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if(error || size < sizeof(Header) || (size - sizeof(Header)) / sizeof(Record) != header.m_capacity ||
+       (size - sizeof(Header)) % sizeof(Record) != 0)
+    {
+        std::cerr << "[Trace::load] " + path.string() + " is truncated or doesn't match its header!" << std::endl;
+        return false;
+    }
+
+    std::vector<Record> ring(header.m_capacity);
+    if(!file.read(reinterpret_cast<char*>(ring.data()), ring.size() * sizeof(Record)))
+    {
+        std::cerr << "[Trace::load] " + path.string() + " is truncated!" << std::endl;
+        return false;
+    }
+
+    /* oldest first */
+    const uint64 count = std::min(header.m_head, header.m_capacity);
+    const uint64 first = header.m_head - count;
+    records.resize(count);
+    for(uint64 i = 0; i < count; i++) records[i] = ring[(first + i) & (header.m_capacity - 1)];
+
+    return true;
+}
+
+void Trace::print(std::ostream& stream, const Record& record)
+{
+    stream << std::setfill(' ') << std::setw(12) << record.m_cycle << std::hex << std::uppercase << std::setfill('0')
+           << "  " << std::setw(4) << record.m_pc << "  " << std::setw(4) << record.m_opcode
+           << "  I=" << std::setw(4) << record.m_I;
+
+    if(record.m_change & changed)
+    {
+        stream << "  V" << (record.m_change & 0xF) << "=" << std::setw(2) << int(record.m_value)
+               << (record.m_change & changed_more ? " +" : "");
+    }
+
+    stream << std::dec << std::nouppercase << std::setfill(' ') << "\n";
+}
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "base.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+namespace emu
+{
+
+/*
+ *  Chip8 Execution Trace:
+ *  -----------------------------
+ *    -> one fixed size record per executed instruction: cycle, PC, opcode, I after it and the V register it changed
+ *    -> records go into a preallocated ring (power of two), the newest capacity records are kept
+ *    -> the ring is either plain memory (save() writes it) or a file mapped into memory, which holds the trace
+ *       even if the process dies (the kernel writes the pages back)
+ *    -> recording is a 16 byte store and a counter increment, nothing allocates
+ *
+ *  File format (little-endian, the in-memory layout):
+ *  -----------------------------
+ *    header: magic "C8TR", version (16-bit), record size (16-bit), reserved (64-bit),
+ *            capacity (64-bit, records), head (64-bit, records written since the start)
+ *    ring:   capacity records, the oldest one at head % capacity once the ring wrapped
+ *    record: cycle (64-bit, Chip8::instructions() before the instruction), PC (16-bit), opcode (16-bit),
+ *            I (16-bit), change (8-bit: bit 7 a register changed, bit 6 more than one did, bits 0-3 the lowest
+ *            changed V index), value of that register (8-bit)
+ *
+ *  -----------------------------
+ */
+struct Trace
+{
+    static constexpr uint16 version = 1;
+
+    struct Record
+    {
+        uint64 m_cycle;
+        uint16 m_pc;
+        uint16 m_opcode;
+        uint16 m_I;
+        uint8 m_change;
+        uint8 m_value;
+    };
+
+    static constexpr uint8 changed = 0x80;
+    static constexpr uint8 changed_more = 0x40;
+
+    struct Header
+    {
+        char m_magic[4];
+        uint16 m_version;
+        uint16 m_record_size;
+        uint64 m_reserved;
+        uint64 m_capacity;
+        uint64 m_head;
+    };
+
+    static_assert(sizeof(Record) == 16 && sizeof(Header) == 32, "records are written as they are laid out in memory");
+    static_assert(std::endian::native == std::endian::little, "the trace format is little-endian");
+
+public:
+    /* ring in memory (capacity is rounded up to a power of two) */
+    explicit Trace(std::size_t capacity = 1 << 20);
+
+    /* ring mapped onto a file (created or truncated; kept in memory and written by the destructor where files
+     * cannot be mapped) */
+    Trace(const std::filesystem::path& path, std::size_t capacity);
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+    ~Trace();
+
+    /* false if the file could not be created or mapped */
+    bool valid() const;
+
+    /* an instruction at pc executed, V before and after it (called by Chip8) */
+    void record(uint64 cycle, uint16 pc, uint16 opcode, uint16 I, const std::array<uint8, 16>& before, const std::array<uint8, 16>& after)
+    {
+        uint64 b[2], a[2];
+        std::memcpy(b, before.data(), 16);
+        std::memcpy(a, after.data(), 16);
+
+        /* lowest changed byte, and whether any other one changed */
+        const uint64 low = a[0] ^ b[0];
+        const uint64 high = a[1] ^ b[1];
+        const int bit = low ? std::countr_zero(low) : 64 + std::countr_zero(high);
+        const int index = bit / 8;
+
+        auto& record = m_records[m_header->m_head & m_mask];
+        record.m_cycle = cycle;
+        record.m_pc = pc;
+        record.m_opcode = opcode;
+        record.m_I = I;
+        if(low | high)
+        {
+            const uint64 others = ~(uint64(0xFF) << (index % 8 * 8));
+            const bool more = index < 8 ? ((low & others) | high) != 0 : (high & others) != 0;
+            record.m_change = changed | (more ? changed_more : 0) | index;
+            record.m_value = after[index];
+        }
+        else
+        {
+            record.m_change = 0;
+            record.m_value = 0;
+        }
+
+        m_header->m_head++;
+    }
+
+    /* records held and records written since the start */
+    std::size_t size() const;
+    uint64 recorded() const;
+    std::size_t capacity() const;
+
+    /* records held, oldest first */
+    std::vector<Record> records() const;
+
+    /* write header and ring (the format above) */
+    bool save(const std::filesystem::path& path) const;
+
+    /* read a trace file, records oldest first */
+    static bool load(const std::filesystem::path& path, std::vector<Record>& records);
+
+    /* one line: cycle, PC, opcode, I, changed register */
+    static void print(std::ostream& stream, const Record& record);
+
+private:
+    Header* m_header = nullptr;
+    Record* m_records = nullptr;
+    uint64 m_mask = 0;
+
+    std::vector<uint8> m_memory;        /* in-memory ring (header and records) */
+    void* m_mapping = nullptr;          /* mapped file */
+    std::size_t m_mapping_size = 0;
+    std::filesystem::path m_path;       /* written by the destructor if it could not be mapped */
+};
+
+}
@@ -0,0 +1,543 @@
+#include "chip8/chip8.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Chip 8 ahead-of-time translator:
+ * ---------------------------
+ *  -> translates a rom into a C++ file of basic block functions and registers it as emu::Aot::Program
+ *     (see chip8/aot.h; CORE_AOT of a program the file is linked into runs it)
+ *  -> control flow is followed from 0x200: jump and call targets, return addresses, both sides of every skip and the
+ *     instruction after FX0A and memory writes (BNNN targets are unknown until runtime and stay interpreted)
+ *  -> the blocks are specialized for one set of quirks, the runtime falls back to the threaded core for others
+ *  -> the file is specific to the build of the translator (chip-8 or XO-CHIP instruction set)
+ *
+ * arguments:
+ *      chip-8-aot <rom> <output.cpp> [--quirks jmsr] [--name title]
+ *
+ *      <rom>: filepath to rom
+ *
+ *      <output.cpp>: generated translation unit
+ *
+ *      --quirks: quirks the rom is run with (j : jumping, m : memory, s : shifting, r : vf reset)
+ *
+ *      --name: name of the program (default: file name of the rom)
+ */
+namespace detail
+{
+
+using emu::uint8;
+using emu::uint16;
+using emu::uint32;
+using emu::detail::eCode;
+
+/* maximum number of instructions per block (the budget of a run is checked between blocks, as in the JIT) */
+constexpr int aot_max_block = 64;
+
+struct Block
+{
+    uint16 m_start = 0;
+    uint32 m_end = 0;
+    std::vector<uint32> m_addresses;        /* instructions of the block */
+};
+
+class Translator
+{
+public:
+    Translator(const std::vector<uint8>& rom, uint8 quirks)
+        : m_memory(emu::Chip8::memory_size, 0), m_rom_size(static_cast<uint32>(rom.size())), m_quirks(quirks)
+    {
+        std::copy(rom.begin(), rom.end(), m_memory.begin() + emu::Chip8::start_addr);
+        m_instructions.select(quirks);
+    }
+
+    /* follow control flow from start_addr, one block per reachable start address */
+    void discover()
+    {
+        std::vector<uint32> pending = { emu::Chip8::start_addr };
+        std::set<uint32> visited;
+
+        while(!pending.empty())
+        {
+            const uint32 start = pending.back();
+            pending.pop_back();
+
+            /* odd addresses and code outside the rom are interpreted */
+            if((start & 0x1) || !inside(start, 2) || !visited.insert(start).second) continue;
+
+            Block block;
+            block.m_start = static_cast<uint16>(start);
+
+            uint32 addr = start;
+            uint32 end = start;
+            bool terminated = false;
+            while(!terminated && block.m_addresses.size() < aot_max_block)
+            {
+                const auto code = decode(addr).m_code;
+                const uint32 next = addr + length(addr);
+                if(!inside(addr, next - addr)) break;
+
+                /* interpreted: the block ends right before (FX0A continues after it) */
+                if(code == eCode::_FX0A) pending.push_back(next);
+                if(code == eCode::_FX0A || code == eCode::_00FD || code == eCode::UNKOWN) break;
+
+                block.m_addresses.push_back(addr);
+                const auto op = decode(addr).m_op_code;
+
+                switch(code)
+                {
+                case eCode::_1NNN:
+                    pending.push_back(op.nnn());
+                    terminated = true;
+                    break;
+                case eCode::_2NNN:
+                    pending.push_back(op.nnn());
+                    pending.push_back(next);
+                    terminated = true;
+                    break;
+                case eCode::_00EE:
+                    terminated = true;
+                    break;
+                case eCode::_BNNN:
+                    m_computed++;
+                    terminated = true;
+                    break;
+                case eCode::_3XNN:
+                case eCode::_4XNN:
+                case eCode::_5XY0:
+                case eCode::_9XY0:
+                case eCode::_EX9E:
+                case eCode::_EXA1:
+                    pending.push_back(next);
+                    pending.push_back(next + skip(addr));
+                    /* XO-CHIP: the skip depends on the length of the instruction after it (F000 NNNN) */
+                    if(emu::Chip8::xo_chip) end = next + 2;
+                    terminated = true;
+                    break;
+                case eCode::_FX33:
+                case eCode::_FX55:
+                case eCode::_5XY2:
+                    pending.push_back(next);
+                    terminated = true;
+                    break;
+                default:
+                    break;
+                }
+
+                addr = next;
+            }
+
+            if(!terminated) pending.push_back(addr);
+            if(block.m_addresses.empty()) continue;
+
+            block.m_end = std::min(std::max(addr, end), emu::Chip8::memory_size);
+            m_blocks.push_back(std::move(block));
+        }
+
+        std::sort(m_blocks.begin(), m_blocks.end(), [](const Block& a, const Block& b) { return a.m_start < b.m_start; });
+    }
+
+    /* the translation unit */
+    void write(std::ostream& stream, const std::string& name) const
+    {
+        stream << "/* " << name << ": translated by chip-8-aot (" << m_blocks.size() << " blocks, quirks 0x"
+               << std::hex << int(m_quirks) << std::dec << "), do not edit */\n"
+               << "#include <chip8/chip8.h>\n\n"
+               << "static_assert(" << (emu::Chip8::xo_chip ? "" : "!") << "emu::Chip8::xo_chip, \"translated by the "
+               << (emu::Chip8::xo_chip ? "XO-CHIP" : "chip-8") << " build of chip-8-aot\");\n\n"
+               << "namespace\n{\n\n"
+               << "using emu::uint8;\nusing emu::uint16;\n\n";
+
+        stream << "const uint8 rom[] =\n{";
+        for(uint32 i = 0; i < m_rom_size; i++)
+        {
+            stream << (i % 16 == 0 ? "\n    " : " ") << "0x" << hex(m_memory[emu::Chip8::start_addr + i], 2) << ",";
+        }
+        stream << "\n};\n\n";
+
+        for(const auto& block : m_blocks)
+        {
+            /* the first pass collects the registers the block touches (they are reloaded after every handler) */
+            uint32 used = 0;
+            std::ostringstream body;
+            translate(body, block, used);
+            body.str("");
+            translate(body, block, used);
+
+            stream << "/* 0x" << hex(block.m_start, 4) << " - 0x" << hex(block.m_end, 4) << ": " << block.m_addresses.size()
+                   << " instructions */\n"
+                   << "void block_" << hex(block.m_start, 4) << "(emu::Aot::State& s)\n{\n";
+            for(int x = 0; x < 16; x++)
+            {
+                if(used & (1 << x)) stream << "    uint8 " << reg(x) << " = " << load(x) << ";\n";
+            }
+            if(used & register_I) stream << "    uint16 I = *s.I;\n";
+            stream << (used ? "\n" : "") << body.str() << "}\n\n";
+        }
+
+        stream << "const emu::Aot::Block blocks[] =\n{\n";
+        for(const auto& block : m_blocks)
+        {
+            stream << "    { 0x" << hex(block.m_start, 4) << ", 0x" << hex(block.m_end, 4) << ", " << block.m_addresses.size()
+                   << ", &block_" << hex(block.m_start, 4) << " },\n";
+        }
+        if(m_blocks.empty()) stream << "    { 0, 0, 0, nullptr }\n";
+        stream << "};\n\n";
+
+        stream << "const emu::Aot::Program program =\n{\n"
+               << "    \"" << escape(name) << "\", rom, sizeof(rom), 0x" << std::hex << int(m_quirks) << std::dec << ", blocks, "
+               << m_blocks.size() << "\n};\n\n"
+               << "const emu::Aot::Registration registration(program);\n\n"
+               << "}\n";
+    }
+
+    /* blocks, instructions and rom bytes translated, BNNN sites */
+    void report(std::ostream& stream) const
+    {
+        std::vector<bool> covered(m_rom_size, false);
+        std::size_t instructions = 0;
+        for(const auto& block : m_blocks)
+        {
+            instructions += block.m_addresses.size();
+            for(auto addr : block.m_addresses)
+            {
+                for(uint32 a = addr; a < addr + length(addr); a++) covered[a - emu::Chip8::start_addr] = true;
+            }
+        }
+
+        stream << "blocks: " << m_blocks.size() << "  instructions: " << instructions
+               << "  rom bytes translated: " << std::count(covered.begin(), covered.end(), true) << " of " << m_rom_size
+               << "  computed jumps (BNNN): " << m_computed << std::endl;
+    }
+
+private:
+    /* bit of I in the used register mask */
+    static constexpr uint32 register_I = 1 << 16;
+
+    emu::Instruction::Decoded decode(uint32 addr) const
+    {
+        return m_instructions.predecode(m_memory[addr] << 8 | m_memory[addr + 1]);
+    }
+
+    /* XO-CHIP F000 NNNN is 4 bytes long */
+    uint32 length(uint32 addr) const
+    {
+        return decode(addr).m_code == eCode::_F000 ? 4 : 2;
+    }
+
+    /* bytes a taken skip at addr jumps over (Chip8::skip_size) */
+    uint32 skip(uint32 addr) const
+    {
+        if constexpr(emu::Chip8::xo_chip) return m_memory[(addr + 2) & 0xFFFF] == 0xF0 && m_memory[(addr + 3) & 0xFFFF] == 0x00 ? 4 : 2;
+        else return 2;
+    }
+
+    /* [addr, addr + size) lies within the rom image */
+    bool inside(uint32 addr, uint32 size) const
+    {
+        return addr >= emu::Chip8::start_addr && addr + size <= emu::Chip8::start_addr + m_rom_size;
+    }
+
+    /* statements of the block; used: V registers (bit x) and I (register_I) the block reads or writes */
+    void translate(std::ostream& out, const Block& block, uint32& used) const
+    {
+        uint32 dirty = 0;
+
+        const auto V = [&used, &dirty](int x, bool write = false) { used |= 1 << x; dirty |= write ? 1 << x : 0; return reg(x); };
+        const auto I = [&used, &dirty](bool write = false) { used |= register_I; dirty |= write ? register_I : 0; return std::string("I"); };
+
+        /* registers changed by the block so far go back into the Chip8 object */
+        const auto flush = [&out, &dirty]()
+        {
+            for(int x = 0; x < 16; x++)
+            {
+                if(dirty & (1 << x)) out << "    s.V[0x" << hex(x, 1) << "] = " << reg(x) << ";\n";
+            }
+            if(dirty & register_I) out << "    *s.I = I;\n";
+            dirty = 0;
+        };
+
+        /* interpreter handler, the locals are written back before and reloaded after */
+        const auto call = [&](uint32 addr)
+        {
+            flush();
+            out << "    emu::Aot::exec(s, 0x" << hex(addr, 4) << ");\n";
+            for(int x = 0; x < 16; x++)
+            {
+                if(used & (1 << x)) out << "    " << reg(x) << " = " << load(x) << ";\n";
+            }
+            if(used & register_I) out << "    I = *s.I;\n";
+        };
+
+        const auto pc = [&out, &flush](const std::string& value)
+        {
+            flush();
+            out << "    *s.PC = " << value << ";\n";
+        };
+
+        const auto shifting = (m_quirks & emu::Chip8::QUIRK_SHIFTING) != 0;
+        bool terminated = false;
+
+        for(const auto addr : block.m_addresses)
+        {
+            const auto decoded = decode(addr);
+            const auto op = decoded.m_op_code;
+            const int x = op.x();
+            const int y = op.y();
+            const uint32 next = addr + length(addr);
+
+            out << "    /* " << hex(addr, 4) << ": " << hex(op.data(), 4) << " */\n";
+
+            switch(decoded.m_code)
+            {
+            case eCode::_6XNN: out << "    " << V(x, true) << " = 0x" << hex(op.nn(), 2) << ";\n"; break;
+            case eCode::_7XNN: out << "    " << V(x, true) << " += 0x" << hex(op.nn(), 2) << ";\n"; break;
+            case eCode::_8XY0: out << "    " << V(x, true) << " = " << V(y) << ";\n"; break;
+
+            case eCode::_8XY1:
+            case eCode::_8XY2:
+            case eCode::_8XY3:
+            {
+                const char* assign = decoded.m_code == eCode::_8XY1 ? " |= " : decoded.m_code == eCode::_8XY2 ? " &= " : " ^= ";
+                out << "    " << V(x, true) << assign << V(y) << ";\n";
+                if(m_quirks & emu::Chip8::QUIRK_VF_RESET) out << "    " << V(0xF, true) << " = 0;\n";
+                break;
+            }
+
+            /* flag first, then the operation on the (possibly changed) operands, as the table handlers do */
+            case eCode::_8XY4:
+                out << "    " << V(0xF, true) << " = " << V(y) << " > 0xFF - " << V(x) << ";\n"
+                    << "    " << V(x, true) << " += " << V(y) << ";\n";
+                break;
+            case eCode::_8XY5:
+                out << "    " << V(0xF, true) << " = !(" << V(y) << " >= " << V(x) << ");\n"
+                    << "    " << V(x, true) << " -= " << V(y) << ";\n";
+                break;
+            case eCode::_8XY7:
+                out << "    " << V(0xF, true) << " = " << V(x) << " <= " << V(y) << ";\n"
+                    << "    " << V(x, true) << " = " << V(y) << " - " << V(x) << ";\n";
+                break;
+            case eCode::_8XY6:
+            {
+                const int src = shifting ? x : y;
+                out << "    " << V(0xF, true) << " = " << V(src) << " & 0x1;\n"
+                    << "    " << V(x, true) << " = " << V(src) << " >> 1;\n";
+                break;
+            }
+            case eCode::_8XYE:
+            {
+                const int src = shifting ? x : y;
+                out << "    " << V(0xF, true) << " = " << V(src) << " >> 7;\n"
+                    << "    " << V(x, true) << " = " << V(src) << " << 1;\n";
+                break;
+            }
+
+            case eCode::_ANNN: out << "    " << I(true) << " = 0x" << hex(op.nnn(), 3) << ";\n"; break;
+            case eCode::_FX07: out << "    " << V(x, true) << " = *s.delay;\n"; break;
+            case eCode::_FX15: out << "    *s.delay = " << V(x) << ";\n"; break;
+            case eCode::_FX18: out << "    *s.sound = " << V(x) << ";\n"; break;
+            case eCode::_FX1E: out << "    " << I(true) << " += " << V(x) << ";\n"; break;
+            case eCode::_FX29: out << "    " << I(true) << " = " << V(x) << " * 0x5;\n"; break;
+            case eCode::_F000: out << "    " << I(true) << " = 0x" << hex(m_memory[addr + 2] << 8 | m_memory[addr + 3], 4) << ";\n"; break;
+
+            case eCode::_FX65:
+                for(int i = 0; i <= x; i++)
+                {
+                    out << "    " << V(i, true) << " = s.memory[(" << I() << " + " << i << ") & 0x" << hex(emu::Chip8::memory_mask, 4) << "];\n";
+                }
+                if(m_quirks & emu::Chip8::QUIRK_MEMORY) out << "    " << I(true) << " += " << x + 1 << ";\n";
+                break;
+
+            /* memory writes end the block (the write may change code) */
+            case eCode::_FX33:
+            case eCode::_FX55:
+            case eCode::_5XY2:
+                call(addr);
+                pc("0x" + hex(next, 4));
+                terminated = true;
+                break;
+
+            /* control flow */
+            case eCode::_1NNN:
+                pc("0x" + hex(op.nnn(), 3));
+                terminated = true;
+                break;
+            case eCode::_2NNN:
+                flush();
+                out << "    s.stack[*s.SP] = 0x" << hex(addr, 4) << ";\n"
+                    << "    ++*s.SP;\n";
+                pc("0x" + hex(op.nnn(), 3));
+                terminated = true;
+                break;
+            case eCode::_00EE:
+                flush();
+                out << "    --*s.SP;\n";
+                pc("s.stack[*s.SP] + 2");
+                terminated = true;
+                break;
+            case eCode::_BNNN:
+                pc(V((m_quirks & emu::Chip8::QUIRK_JUMPING) ? x : 0) + " + 0x" + hex(op.nnn(), 3));
+                terminated = true;
+                break;
+
+            /* skips: both targets are known */
+            case eCode::_3XNN:
+            case eCode::_4XNN:
+            case eCode::_5XY0:
+            case eCode::_9XY0:
+            case eCode::_EX9E:
+            case eCode::_EXA1:
+            {
+                std::string condition;
+                if(decoded.m_code == eCode::_3XNN) condition = V(x) + " == 0x" + hex(op.nn(), 2);
+                if(decoded.m_code == eCode::_4XNN) condition = V(x) + " != 0x" + hex(op.nn(), 2);
+                if(decoded.m_code == eCode::_5XY0) condition = V(x) + " == " + V(y);
+                if(decoded.m_code == eCode::_9XY0) condition = V(x) + " != " + V(y);
+                if(decoded.m_code == eCode::_EX9E) condition = "s.keypad[" + V(x) + "]";
+                if(decoded.m_code == eCode::_EXA1) condition = "!s.keypad[" + V(x) + "]";
+
+                pc(condition + " ? 0x" + hex(next + skip(addr), 4) + " : 0x" + hex(next, 4));
+                terminated = true;
+                break;
+            }
+
+            /* display, random numbers, SUPER-CHIP / XO-CHIP: interpreter handlers */
+            default:
+                call(addr);
+                break;
+            }
+        }
+
+        if(!terminated) pc("0x" + hex(block.m_addresses.back() + length(block.m_addresses.back()), 4));
+    }
+
+    static std::string reg(int x)
+    {
+        return { 'v', "0123456789ABCDEF"[x & 0xF] };
+    }
+
+    static std::string load(int x)
+    {
+        return "s.V[0x" + hex(x, 1) + "]";
+    }
+
+    static std::string hex(uint32 value, int digits)
+    {
+        std::ostringstream stream;
+        stream << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value;
+        return stream.str();
+    }
+
+    /* C string literal contents */
+    static std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        for(char c : text)
+        {
+            if(c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+private:
+    std::vector<uint8> m_memory;
+    uint32 m_rom_size;
+    uint8 m_quirks;
+    mutable emu::Instruction m_instructions;     /* predecode() is not const */
+
+    std::vector<Block> m_blocks;
+    std::size_t m_computed = 0;
+};
+
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "[chip-8-aot] Missing rom or output file." << std::endl;
+        std::cerr << "             Usage: " << "chip-8-aot " << "<rom> <output.cpp> [--quirks jmsr] [--name title]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    emu::Chip8::Settings settings;
+    std::string name = std::filesystem::path(argv[1]).filename().string();
+
+    /* parse options */
+    for(int i = 3; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if(arg == "--quirks" && i + 1 < argc)
+        {
+            std::string options(argv[i+1]);
+            for(char o : options)
+            {
+                switch (o)
+                {
+                    case 'j': settings.m_jumping = true; break;
+                    case 'm': settings.m_memory = true; break;
+                    case 's': settings.m_shifting = true; break;
+                    case 'r': settings.m_vf_reset = true; break;
+                default: break;
+                }
+            }
+
+            i++;
+        }
+        else if(arg == "--name" && i + 1 < argc)
+        {
+            name = argv[i+1];
+
+            i++;
+        }
+        else
+        {
+            std::cerr << "[chip-8-aot] Unknown option: " << arg << std::endl;
+        }
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "[chip-8-aot] Couldn't load rom file: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<emu::uint8> rom(std::istreambuf_iterator<char>(file), {});
+    if(rom.empty())
+    {
+        /* nothing to translate (and an empty rom array would not compile) */
+        std::cerr << "[chip-8-aot] Rom is empty: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    if(rom.size() > emu::Chip8::end_addr - emu::Chip8::start_addr)
+    {
+        std::cerr << "[chip-8-aot] Rom size too large: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    detail::Translator translator(rom, settings.quirks());
+    translator.discover();
+
+    std::ofstream output(argv[2]);
+    translator.write(output, name);
+    if(!output)
+    {
+        std::cerr << "[chip-8-aot] Couldn't write output file: " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    translator.report(std::cout);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,537 @@
+#include "chip8/batch.h"
+#include "chip8/chip8.h"
+#include "chip8/hash.h"
+#include "runner/input.h"
+#include "runner/runner.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Chip 8 rom corpus benchmark:
+ * ---------------------------
+ *  -> runs every .ch8 under <roms>/games, <roms>/demos and <roms>/programs headless for a fixed number of frames
+ *  -> input is fixed (built-in key pattern or --input script), so runs are comparable between builds and cores
+ *  -> per rom and for the whole corpus: instructions per second, ns per instruction, ns per tick, opcode mix
+ *     and a hash of the final framebuffer (catches behavioural changes)
+ *  -> the opcode mix is counted in a separate untimed pass (table interpreter)
+ *  -> --threads runs the corpus on the multi-instance runner instead (runner/runner.h) and prints its report
+ *  -> --batch runs every rom on the N lanes of a lockstep batch instead (chip8/batch.h) and checks each lane
+ *     against a scalar Chip8 on the selected core
+ *
+ * arguments:
+ *      chip-8-bench [--roms roms] [--frames 3600] [--speed 500] [--quirks jmsr] [--core table] [--repeat 3] [--input script] [--no-idle-skip] [--format csv|json] [--threads N] [--batch 8|16|32]
+ *
+ *      --roms: corpus root directory (default roms)
+ *      --frames: 60hz frames per rom (default 3600)
+ *      --speed: instructions per second (default 500; exact, fractional instructions per frame are carried)
+ *      --repeat: timed runs per rom, the fastest is reported (default 3)
+ *      --no-idle-skip: execute idle loops instead of skipping them (instructions skipped by the idle loop
+ *                      detection count as executed, so by default the rates are effective rates)
+ *      --format: csv (default) or json on stdout
+ *      --threads: run every rom --repeat times as independent jobs on N workers (0: one per hardware thread), print the
+ *                 throughput per worker and the corpus display hash (equals the display_hash of TOTAL without --threads)
+ *      --batch: run every rom on 8, 16 or 32 lockstep lanes (lane i presses the keys of the built-in pattern shifted
+ *               by i) and on one scalar Chip8 per lane, compare display hash and registers of each lane, print csv
+ *               (seconds of the batch and of the scalar machines, lockstep steps with a single group) and fail
+ *               on a mismatch; Chip8Batch has no fractional speed, both run speed / 60 instructions per tick
+ */
+namespace detail
+{
+
+using Mix = std::array<emu::uint64, emu::detail::eCode::UNKOWN + 1>;
+
+struct Result
+{
+    std::string m_name;
+    emu::uint64 m_instructions = 0;
+    emu::uint64 m_frames = 0;
+    double m_seconds = 0.0;
+    emu::uint64 m_hash = 0;
+    Mix m_mix = {};
+};
+
+struct Options
+{
+    std::filesystem::path m_roms = "roms";
+    emu::uint32 m_frames = 3600;
+    int m_repeat = 3;
+    bool m_json = false;
+    bool m_runner = false;
+    unsigned int m_threads = 0;
+    std::size_t m_batch = 0;
+    emu::Chip8::Settings m_settings;
+    std::shared_ptr<InputScript> m_input;
+};
+
+/* built-in input: every 20 frames one key (cycling through all 16, starting at offset) is held for 5 frames */
+void fixed_input(emu::uint32 frame, emu::Chip8::Keypad& keypad, emu::uint32 offset = 0)
+{
+    keypad.fill(false);
+    if(frame % 20 < 5) keypad[(frame / 20 + offset) % emu::Chip8::COUNT] = true;
+}
+
+/* fixed_input() as input script (runner jobs take scripts) */
+std::shared_ptr<InputScript> fixed_script(emu::uint32 frames)
+{
+    std::stringstream script;
+    script << std::hex << std::uppercase;
+    for(emu::uint32 frame = 0; frame < frames; frame += 20)
+    {
+        const auto key = (frame / 20) % emu::Chip8::COUNT;
+        script << std::dec << frame << std::hex << " " << key << " down\n";
+        script << std::dec << frame + 5 << std::hex << " " << key << " up\n";
+    }
+
+    auto input = std::make_shared<InputScript>();
+    input->parse(script);
+    return input;
+}
+
+std::vector<emu::uint8> read(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<emu::uint8>(std::istreambuf_iterator<char>(file), {});
+}
+
+std::unique_ptr<emu::Chip8> create(const Options& options, const std::vector<emu::uint8>& rom)
+{
+    auto chip8 = std::make_unique<emu::Chip8>();
+    chip8->settings() = options.m_settings;
+    if(!chip8->load_rom(rom)) return nullptr;
+
+    return chip8;
+}
+
+/* timed run on the selected core (fastest of m_repeat) */
+bool measure(const Options& options, const std::vector<emu::uint8>& rom, Result& result)
+{
+    result.m_frames = options.m_frames;
+    result.m_seconds = INFINITY;
+
+    for(int r = 0; r < options.m_repeat; r++)
+    {
+        auto chip8 = create(options, rom);
+        if(!chip8) return false;
+
+        std::size_t cursor = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for(emu::uint32 frame = 0; frame < options.m_frames; frame++)
+        {
+            if(options.m_input) options.m_input->apply(frame, chip8->keypad(), cursor);
+            else fixed_input(frame, chip8->keypad());
+
+            chip8->tick();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.m_seconds = std::min(result.m_seconds, seconds);
+        result.m_instructions = chip8->instructions();
+        result.m_hash = emu::hash(chip8->display());
+    }
+
+    return true;
+}
+
+/* untimed run counting executed opcodes (same instruction stream as tick() == run(tick_cycles()) + tick_timers(),
+ * one execute_cycle at a time) */
+void count(const Options& options, const std::vector<emu::uint8>& rom, Result& result)
+{
+    auto chip8 = create(options, rom);
+    if(!chip8) return;
+
+    emu::Instruction decoder;
+    decoder.select(options.m_settings.quirks());
+
+    auto& settings = chip8->settings();
+    settings.m_core = emu::Chip8::CORE_TABLE;
+
+    std::size_t cursor = 0;
+    for(emu::uint32 frame = 0; frame < options.m_frames; frame++)
+    {
+        if(options.m_input) options.m_input->apply(frame, chip8->keypad(), cursor);
+        else fixed_input(frame, chip8->keypad());
+
+        const int cycles = chip8->tick_cycles();
+        for(int i = 0; i < cycles; i++)
+        {
+            const auto pc = chip8->regs().PC;
+            const auto& memory = chip8->memory();
+            const emu::uint16 op_code = memory[pc % emu::Chip8::memory_size] << 8 | memory[(pc + 1) % emu::Chip8::memory_size];
+
+            result.m_mix[decoder.predecode(op_code).m_code]++;
+            chip8->execute_cycle();
+        }
+
+        chip8->tick_timers();
+    }
+}
+
+/* every rom m_repeat times as independent jobs on the runner's work-stealing pool */
+bool run_threads(const Options& options, const std::vector<std::filesystem::path>& roms, std::ostream& stream)
+{
+    const auto input = options.m_input ? options.m_input : fixed_script(options.m_frames);
+
+    std::vector<Runner::Job> jobs(roms.size());
+    for(std::size_t i = 0; i < roms.size(); i++)
+    {
+        jobs[i].m_rom = std::make_shared<const std::vector<emu::uint8>>(read(roms[i]));
+        jobs[i].m_settings = options.m_settings;
+        jobs[i].m_input = input;
+        jobs[i].m_frames = options.m_frames;
+    }
+
+    /* repetitions after all roms (the hash is taken from the first) */
+    for(int r = 1; r < options.m_repeat; r++)
+    {
+        for(std::size_t i = 0; i < roms.size(); i++) jobs.push_back(jobs[i]);
+    }
+
+    Runner runner(options.m_threads);
+    const auto results = runner.run(jobs);
+
+    emu::uint64 hash = 0;
+    std::size_t loaded = 0;
+    for(std::size_t i = 0; i < roms.size(); i++)
+    {
+        if(!results[i].m_loaded)
+        {
+            std::cerr << "[chip-8-bench] Skipping " << std::filesystem::relative(roms[i], options.m_roms).generic_string() << std::endl;
+            continue;
+        }
+
+        hash = hash * 31 + emu::hash(results[i].m_display);
+        loaded++;
+    }
+
+    stream << runner.report();
+    stream << "roms: " << loaded << "  jobs: " << jobs.size() << "  threads: " << runner.threads()
+           << "  display hash: " << std::hex << std::setfill('0') << std::setw(16) << hash << std::dec << std::setfill(' ') << "\n";
+
+    return loaded > 0;
+}
+
+/* lockstep batch against one scalar machine per lane, false on a mismatch */
+template<std::size_t N>
+bool run_batch(const Options& options, const std::vector<emu::uint8>& rom, const std::string& name, std::ostream& stream)
+{
+    auto settings = options.m_settings;
+    settings.m_cycles = std::max(1, settings.m_speed / emu::Chip8::tick_rate);
+    settings.m_speed = 0;
+
+    auto batch = std::make_unique<emu::Chip8Batch<N>>();
+    batch->settings() = settings;
+    if(!batch->load_rom(rom))
+    {
+        std::cerr << "[chip-8-bench] Skipping " << name << std::endl;
+        return true;
+    }
+
+    std::vector<std::unique_ptr<emu::Chip8>> scalar;
+    for(std::size_t l = 0; l < N; l++)
+    {
+        scalar.push_back(std::make_unique<emu::Chip8>());
+        scalar[l]->settings() = settings;
+        scalar[l]->load_rom(rom);
+    }
+
+    std::vector<std::size_t> cursors(N, 0);
+    const auto input = [&](emu::uint32 frame, std::size_t lane, emu::Chip8::Keypad& keypad)
+    {
+        if(options.m_input) options.m_input->apply(frame, keypad, cursors[lane]);
+        else fixed_input(frame, keypad, static_cast<emu::uint32>(lane));
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for(emu::uint32 frame = 0; frame < options.m_frames; frame++)
+    {
+        for(std::size_t l = 0; l < N; l++) input(frame, l, batch->keypad(l));
+        batch->tick();
+    }
+    const double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::fill(cursors.begin(), cursors.end(), 0);
+    const auto scalar_start = std::chrono::steady_clock::now();
+    for(std::size_t l = 0; l < N; l++)
+    {
+        for(emu::uint32 frame = 0; frame < options.m_frames; frame++)
+        {
+            input(frame, l, scalar[l]->keypad());
+            scalar[l]->tick();
+        }
+    }
+    const double scalar_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - scalar_start).count();
+
+    std::size_t mismatches = 0;
+    for(std::size_t l = 0; l < N; l++)
+    {
+        const auto& lane = batch->lane(l).regs();
+        const auto& expected = scalar[l]->regs();
+
+        const bool same = emu::hash(batch->lane(l).display()) == emu::hash(scalar[l]->display()) &&
+                          lane.V == expected.V && lane.I == expected.I && lane.PC == expected.PC && lane.SP == expected.SP &&
+                          lane.timer_delay == expected.timer_delay && lane.timer_sound == expected.timer_sound;
+        if(same) continue;
+
+        std::cerr << "[chip-8-bench] " << name << ": lane " << l << " differs from the scalar machine" << std::endl;
+        mismatches++;
+    }
+
+    const auto& stats = batch->stats();
+    stream << "\"" << name << "\"," << N << "," << std::setprecision(6) << batch_seconds << "," << scalar_seconds << ","
+           << std::fixed << std::setprecision(1) << (stats.m_steps ? 100.0 * stats.m_converged / stats.m_steps : 0.0)
+           << std::defaultfloat << "," << stats.m_scalar_lanes << "," << mismatches << "\n";
+
+    return mismatches == 0;
+}
+
+void print_csv(std::ostream& stream, const std::vector<Result>& results)
+{
+    stream << "rom,instructions,frames,seconds,ips,ns_per_instruction,ns_per_tick,display_hash";
+    for(int op = 0; op <= emu::detail::eCode::UNKOWN; op++) stream << "," << emu::Instruction::name(emu::detail::eCode(op));
+    stream << "\n";
+
+    for(const auto& result : results)
+    {
+        stream << "\"" << result.m_name << "\"," << result.m_instructions << "," << result.m_frames << ","
+               << std::setprecision(6) << result.m_seconds << ","
+               << std::fixed << std::setprecision(0) << result.m_instructions / result.m_seconds << ","
+               << std::setprecision(3) << 1e9 * result.m_seconds / result.m_instructions << ","
+               << std::setprecision(1) << 1e9 * result.m_seconds / result.m_frames << std::defaultfloat << ","
+               << std::hex << std::setfill('0') << std::setw(16) << result.m_hash << std::dec << std::setfill(' ');
+        for(auto count : result.m_mix) stream << "," << count;
+        stream << "\n";
+    }
+}
+
+void print_json(std::ostream& stream, const Options& options, const std::vector<Result>& results)
+{
+    static const char* cores[] = { "table", "threaded", "jit", "aot" };
+
+    stream << "{\n";
+    stream << "  \"core\": \"" << cores[options.m_settings.m_core] << "\",\n";
+    stream << "  \"frames\": " << options.m_frames << ",\n";
+    stream << "  \"speed\": " << options.m_settings.m_speed << ",\n";
+    stream << "  \"quirks\": " << int(options.m_settings.quirks()) << ",\n";
+    stream << "  \"results\": [\n";
+
+    for(std::size_t i = 0; i < results.size(); i++)
+    {
+        const auto& result = results[i];
+
+        std::string name;
+        for(char c : result.m_name)
+        {
+            if(c == '"' || c == '\\') name += '\\';
+            name += c;
+        }
+
+        stream << "    { \"rom\": \"" << name << "\", \"instructions\": " << result.m_instructions << ", \"frames\": " << result.m_frames
+               << ", \"seconds\": " << std::setprecision(6) << result.m_seconds
+               << ", \"ips\": " << std::fixed << std::setprecision(0) << result.m_instructions / result.m_seconds
+               << ", \"ns_per_instruction\": " << std::setprecision(3) << 1e9 * result.m_seconds / result.m_instructions
+               << ", \"ns_per_tick\": " << std::setprecision(1) << 1e9 * result.m_seconds / result.m_frames << std::defaultfloat
+               << ", \"display_hash\": \"" << std::hex << std::setfill('0') << std::setw(16) << result.m_hash << std::dec << std::setfill(' ') << "\""
+               << ", \"mix\": {";
+
+        for(int op = 0; op <= emu::detail::eCode::UNKOWN; op++)
+        {
+            stream << (op ? ", " : " ") << "\"" << emu::Instruction::name(emu::detail::eCode(op)) << "\": " << result.m_mix[op];
+        }
+        stream << " } }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    stream << "  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    detail::Options options;
+    options.m_settings.m_speed = 500;
+
+    const char* usage = "               Usage: chip-8-bench [--roms roms] [--frames 3600] [--speed 500] [--quirks jmsr] [--core table] [--repeat 3] [--input script] [--no-idle-skip] [--format csv|json] [--threads N] [--batch 8|16|32]";
+
+    /* parse options */
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        const bool value = i + 1 < argc;
+
+        if(arg == "--roms" && value)
+        {
+            options.m_roms = argv[++i];
+        }
+        else if(arg == "--frames" && value)
+        {
+            options.m_frames = static_cast<emu::uint32>(std::abs(std::atol(argv[++i])));
+        }
+        else if(arg == "--speed" && value)
+        {
+            options.m_settings.m_speed = std::max(1, std::abs(std::atoi(argv[++i])));
+        }
+        else if(arg == "--quirks" && value)
+        {
+            std::string quirks(argv[++i]);
+            for(char o : quirks)
+            {
+                switch (o)
+                {
+                    case 'j': options.m_settings.m_jumping = true; break;
+                    case 'm': options.m_settings.m_memory = true; break;
+                    case 's': options.m_settings.m_shifting = true; break;
+                    case 'r': options.m_settings.m_vf_reset = true; break;
+                default: break;
+                }
+            }
+        }
+        else if(arg == "--core" && value)
+        {
+            std::string core(argv[++i]);
+            if(core == "table") options.m_settings.m_core = emu::Chip8::CORE_TABLE;
+            if(core == "threaded") options.m_settings.m_core = emu::Chip8::CORE_THREADED;
+            if(core == "jit") options.m_settings.m_core = emu::Chip8::CORE_JIT;
+            if(core == "aot") options.m_settings.m_core = emu::Chip8::CORE_AOT;
+        }
+        else if(arg == "--repeat" && value)
+        {
+            options.m_repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg == "--input" && value)
+        {
+            options.m_input = std::make_shared<InputScript>();
+            if(!options.m_input->load(argv[++i])) return EXIT_FAILURE;
+        }
+        else if(arg == "--no-idle-skip")
+        {
+            options.m_settings.m_idle_skip = false;
+        }
+        else if(arg == "--threads" && value)
+        {
+            options.m_runner = true;
+            options.m_threads = static_cast<unsigned int>(std::abs(std::atoi(argv[++i])));
+        }
+        else if(arg == "--batch" && value)
+        {
+            options.m_batch = static_cast<std::size_t>(std::atoi(argv[++i]));
+            if(options.m_batch != 8 && options.m_batch != 16 && options.m_batch != 32)
+            {
+                std::cerr << "[chip-8-bench] Batch lanes must be 8, 16 or 32: " << argv[i] << std::endl;
+                std::cerr << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(arg == "--format" && value)
+        {
+            std::string format(argv[++i]);
+            if(format != "csv" && format != "json")
+            {
+                std::cerr << "[chip-8-bench] Unknown format: " << format << std::endl;
+                std::cerr << usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            options.m_json = format == "json";
+        }
+        else
+        {
+            std::cerr << "[chip-8-bench] Unknown option: " << arg << std::endl;
+            std::cerr << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* corpus in stable order (diffable output) */
+    std::vector<std::filesystem::path> roms;
+    for(const auto* folder : { "games", "demos", "programs" })
+    {
+        const auto directory = options.m_roms / folder;
+        if(!std::filesystem::is_directory(directory)) continue;
+
+        std::vector<std::filesystem::path> files;
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+        {
+            if(entry.is_regular_file() && entry.path().extension() == ".ch8") files.push_back(entry.path());
+        }
+
+        std::sort(files.begin(), files.end());
+        roms.insert(roms.end(), files.begin(), files.end());
+    }
+
+    if(roms.empty())
+    {
+        std::cerr << "[chip-8-bench] No roms found in " << options.m_roms << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(options.m_runner)
+    {
+        return detail::run_threads(options, roms, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(options.m_batch)
+    {
+        std::cout << "rom,lanes,batch_seconds,scalar_seconds,converged_percent,scalar_lane_instructions,mismatches\n";
+
+        bool passed = true;
+        for(const auto& path : roms)
+        {
+            const auto rom = detail::read(path);
+            const auto name = std::filesystem::relative(path, options.m_roms).generic_string();
+
+            switch(options.m_batch)
+            {
+                case 8: passed &= detail::run_batch<8>(options, rom, name, std::cout); break;
+                case 16: passed &= detail::run_batch<16>(options, rom, name, std::cout); break;
+                default: passed &= detail::run_batch<32>(options, rom, name, std::cout); break;
+            }
+        }
+
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::vector<detail::Result> results;
+    detail::Result total;
+    total.m_name = "TOTAL";
+
+    for(const auto& path : roms)
+    {
+        const auto rom = detail::read(path);
+
+        detail::Result result;
+        result.m_name = std::filesystem::relative(path, options.m_roms).generic_string();
+
+        if(!detail::measure(options, rom, result))
+        {
+            std::cerr << "[chip-8-bench] Skipping " << result.m_name << std::endl;
+            continue;
+        }
+        detail::count(options, rom, result);
+
+        total.m_instructions += result.m_instructions;
+        total.m_frames += result.m_frames;
+        total.m_seconds += result.m_seconds;
+        total.m_hash = total.m_hash * 31 + result.m_hash;
+        for(std::size_t op = 0; op < total.m_mix.size(); op++) total.m_mix[op] += result.m_mix[op];
+
+        results.push_back(result);
+    }
+
+    results.push_back(total);
+
+    if(options.m_json) detail::print_json(std::cout, options, results);
+    else detail::print_csv(std::cout, results);
+
+    return EXIT_SUCCESS;
+}
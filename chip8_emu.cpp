@@ -1,6 +1,6 @@
 #include "viewer/viewer.h"
 
-#include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 
@@ -8,7 +8,7 @@
  * Chip 8 emulation program:
  * ---------------------------
  * arguments:
- *      chip-8-emu " << "<path> [--quirks jmsr] [--speed 500]
+ *      chip-8-emu " << "<path> [--quirks jmsr] [--speed 500] [--core table] [--seed 0] [--record log] [--replay log] [--turbo 4] [--audio-latency 25] [--profile file.json] [--trace file]
  *
  *      <path>: filepath to rom
  *
@@ -18,14 +18,35 @@
  *               s : shifting
  *               r : vf reset
  *
- *      --speed: optional speed in hz (default 500hz)
+ *      --speed: optional speed in hz (default 500hz; exact, fractional instructions per frame are carried)
+ *
+ *      --core: optional execution core
+ *               table    : function table interpreter (default)
+ *               threaded : threaded code interpreter
+ *               jit      : x86-64 basic block recompiler
+ *               aot      : blocks translated ahead of time by chip-8-aot (threaded without a linked translation)
+ *
+ *      --seed: seed of the CXNN random number generator (default 0)
+ *
+ *      --record: record keypad and settings changes to an input log (written on exit)
+ *
+ *      --replay: replay an input log (seed and settings from the log)
+ *
+ *      --turbo: start in fast forward at a multiple of the normal speed (0: as fast as possible; tab toggles)
+ *
+ *      --audio-latency: bound of the audio latency in ms (default 25; space prints the measured latency)
+ *
+ *      --profile: write the execution profile as JSON on exit (CHIP8_PROFILE builds; space prints it)
+ *
+ *      --trace: record the newest 2^20 instructions into a memory mapped trace file (kept if the program crashes;
+ *               chip-8-trace prints it)
  */
 int main(int argc, char** argv)
 {
     if(argc < 2)
     {
         std::cerr << "[chip-8-emu] Missing rom file." << std::endl;
-        std::cerr << "             Usage: " << "chip-8-emu " << "<path> [--quirks jmsr] [--speed 500]" << std::endl;
+        std::cerr << "             Usage: " << "chip-8-emu " << "<path> [--quirks jmsr] [--speed 500] [--core table] [--seed 0] [--record log] [--replay log] [--turbo 4] [--audio-latency 25] [--profile file.json] [--trace file]" << std::endl;
         return EXIT_FAILURE;
     }
 
@@ -35,7 +56,7 @@ int main(int argc, char** argv)
 
     /* emulation default settings */
     auto& settings = emulator.settings();
-    settings.m_cycles = static_cast<int>(std::ceil(500 / 60.0f));
+    settings.m_speed = 500;
     settings.m_jumping = false;
     settings.m_memory = false;
     settings.m_shifting = false;
@@ -48,6 +69,10 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    emu::uint32 seed = 0;
+    std::string record_path;
+    std::string replay_path;
+
     /* parse options */
     for(int i = 2; i < argc; i++)
     {
@@ -73,11 +98,92 @@ int main(int argc, char** argv)
 
         if(arg == "--speed" && argc >= i + 1)
         {
-            int speed = std::abs(std::atoi(argv[i+1]));
-            settings.m_cycles = static_cast<int>(std::ceil(speed / 60.0f));
+            settings.m_speed = std::max(1, std::abs(std::atoi(argv[i+1])));
+
+            i++;
+        }
+
+        if(arg == "--core" && argc >= i + 1)
+        {
+            std::string core(argv[i+1]);
+            if(core == "table") settings.m_core = emu::Chip8::CORE_TABLE;
+            if(core == "threaded") settings.m_core = emu::Chip8::CORE_THREADED;
+            if(core == "jit") settings.m_core = emu::Chip8::CORE_JIT;
+            if(core == "aot") settings.m_core = emu::Chip8::CORE_AOT;
+
+            i++;
+        }
+
+        if(arg == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<emu::uint32>(std::strtoul(argv[i+1], nullptr, 0));
+
+            i++;
+        }
+
+        if(arg == "--record" && i + 1 < argc)
+        {
+            record_path = argv[i+1];
+
+            i++;
+        }
+
+        if(arg == "--replay" && i + 1 < argc)
+        {
+            replay_path = argv[i+1];
 
             i++;
         }
+
+        if(arg == "--turbo" && i + 1 < argc)
+        {
+            viewer.turbo(std::atoi(argv[i+1]), true);
+
+            i++;
+        }
+
+        if(arg == "--audio-latency" && i + 1 < argc)
+        {
+            viewer.audio_latency(std::abs(std::atof(argv[i+1])) / 1000.0);
+
+            i++;
+        }
+
+        if(arg == "--profile" && i + 1 < argc)
+        {
+            if(!emu::Chip8::profiling) std::cerr << "[chip-8-emu] Built without CHIP8_PROFILE, no profile is recorded." << std::endl;
+            viewer.profile(argv[i+1]);
+
+            i++;
+        }
+
+        if(arg == "--trace" && i + 1 < argc)
+        {
+            auto trace = std::make_unique<emu::Trace>(std::filesystem::path(argv[i+1]), 1 << 20);
+            if(!trace->valid())
+            {
+                std::cerr << "[chip-8-emu] Couldn't create trace file: " << argv[i+1] << std::endl;
+                return EXIT_FAILURE;
+            }
+            emulator.trace(std::move(trace));
+
+            i++;
+        }
+    }
+
+    /* input log (replay takes seed and settings from the log) */
+    emulator.seed(seed);
+    if(!replay_path.empty())
+    {
+        if(!viewer.replay(replay_path))
+        {
+            std::cerr << "[chip-8-emu] Couldn't load input log: " << replay_path << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else if(!record_path.empty())
+    {
+        viewer.record(record_path, seed);
     }
 
     /* start emulation */
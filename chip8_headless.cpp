@@ -0,0 +1,483 @@
+#include "chip8/chip8.h"
+#include "chip8/hash.h"
+#include "chip8/input_log.h"
+#include "chip8/rewind.h"
+#include "chip8/synth.h"
+#include "runner/input.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/*
+ * Chip 8 headless emulation program:
+ * ---------------------------
+ *  -> runs a rom for a fixed number of frames without window, audio device or frame limiter
+ *  -> while FX0A waits for a key, the frames up to the next input event are skipped (only the timers run)
+ *
+ * arguments:
+ *      chip-8-headless <path> [--quirks jmsr] [--speed 500] [--core table] [--frames 600] [--input script] [--seed 0] [--record log] [--replay log] [--no-idle-skip] [--load-state file] [--save-state file] [--rewind] [--wav file.wav] [--profile [file.json]] [--trace file [--trace-size 1048576]] [--dump [file.pbm]]
+ *
+ *      <path>: filepath to rom
+ *
+ *      --quirks: optional quirks (the complete set, flags not given are off)
+ *               j : jumping
+ *               m : memory
+ *               s : shifting
+ *               r : vf reset
+ *
+ *      --speed: optional speed in hz (default 500hz; exact, fractional instructions per frame are carried)
+ *
+ *      --core: optional execution core (table, threaded, jit, aot; aot needs a rom translated by chip-8-aot
+ *              and linked into this program, see chip8/aot.h)
+ *
+ *      --frames: number of 60hz frames to run (default 600)
+ *
+ *      --input: optional input script (see runner/input.h)
+ *
+ *      --seed: seed of the CXNN random number generator (default 0; with --load-state the generator of the state is kept
+ *              unless --seed or --record is given)
+ *
+ *      --record: write the keypad changes of the run (with seed and settings) to an input log (see chip8/input_log.h)
+ *
+ *      --replay: replay an input log bit-exactly (seed, settings and keypad from the log; --input is ignored)
+ *
+ *      --no-idle-skip: execute idle loops instead of skipping the rest of the tick
+ *
+ *      --load-state: resume from a save state before the first frame (see chip8/state.cpp); the state is loaded after
+ *                    all options are parsed and replaces quirks, speed and core, an explicit --quirks, --speed or
+ *                    --core is applied on top of it wherever it appears on the command line
+ *
+ *      --save-state: write a save state after the last frame
+ *
+ *      --rewind: record every frame into a rewind buffer and report its memory and time budget
+ *
+ *      --wav: render the buzzer of every frame into a WAV file (48 khz, 16-bit mono; see chip8/synth.h)
+ *
+ *      --profile: print the execution profile (opcodes, hottest addresses and call targets) after the last frame,
+ *                 or write it as JSON to file.json (CHIP8_PROFILE builds; see chip8/profile.h)
+ *
+ *      --trace: record every instruction into a trace file (memory mapped ring of the newest --trace-size records;
+ *               see chip8/trace.h, chip-8-trace prints it)
+ *
+ *      --dump: print framebuffer hash and register state after the last frame,
+ *              optionally write the framebuffer as PBM image to file.pbm
+ */
+namespace detail
+{
+
+/* plain PBM (P1), one character per pixel */
+bool write_pbm(const std::string& path, const emu::Chip8::Display& display)
+{
+    std::ofstream file(path);
+    if(!file) return false;
+
+    file << "P1\n" << display.width() << " " << display.height() << "\n";
+    for(int y = 0; y < display.height(); y++)
+    {
+        for(int x = 0; x < display.width(); x++)
+        {
+            file << (display.pixel(x, y) ? '1' : '0') << (x + 1 < display.width() ? " " : "\n");
+        }
+    }
+
+    return bool(file);
+}
+
+/* 16-bit mono PCM WAV, finish() fills in the sizes of the header */
+class WavWriter
+{
+public:
+    bool open(const std::string& path)
+    {
+        m_file.open(path, std::ios::binary);
+        header(0);
+        return bool(m_file);
+    }
+
+    bool is_open() const
+    {
+        return m_file.is_open();
+    }
+
+    void write(const emu::Synth::Block& block)
+    {
+        for(const auto sample : block) put(static_cast<emu::uint16>(sample), 2);
+        m_samples += block.size();
+    }
+
+    bool finish()
+    {
+        m_file.seekp(0);
+        header(m_samples * 2);
+        m_file.close();
+        return !m_file.fail();
+    }
+
+private:
+    void header(emu::uint32 data)
+    {
+        m_file.write("RIFF", 4);
+        put(36 + data, 4);
+        m_file.write("WAVEfmt ", 8);
+        put(16, 4);                                 /* fmt chunk: PCM, mono */
+        put(1, 2);
+        put(1, 2);
+        put(emu::Synth::sample_rate, 4);
+        put(emu::Synth::sample_rate * 2, 4);        /* bytes per second, per frame, bits per sample */
+        put(2, 2);
+        put(16, 2);
+        m_file.write("data", 4);
+        put(data, 4);
+    }
+
+    /* little-endian */
+    void put(emu::uint32 value, int bytes)
+    {
+        for(int i = 0; i < bytes; i++) m_file.put(static_cast<char>(value >> (8 * i)));
+    }
+
+private:
+    std::ofstream m_file;
+    emu::uint32 m_samples = 0;
+};
+
+void print_registers(std::ostream& stream, const emu::Chip8::Registers& regs)
+{
+    stream << std::hex << std::setfill('0');
+    for(int i = 0; i < 16; i++)
+    {
+        stream << "V" << std::uppercase << i << std::nouppercase << "=" << std::setw(2) << int(regs.V[i]) << (i % 8 == 7 ? "\n" : " ");
+    }
+    stream << "I=" << std::setw(4) << regs.I << " PC=" << std::setw(4) << regs.PC << " SP=" << std::setw(4) << regs.SP
+           << " DT=" << std::setw(2) << int(regs.timer_delay) << " ST=" << std::setw(2) << int(regs.timer_sound) << "\n";
+    stream << std::dec << std::setfill(' ');
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << "[chip-8-headless] Missing rom file." << std::endl;
+        std::cerr << "                  Usage: " << "chip-8-headless " << "<path> [--quirks jmsr] [--speed 500] [--core table] [--frames 600] [--input script] [--seed 0] [--record log] [--replay log] [--no-idle-skip] [--load-state file] [--save-state file] [--rewind] [--wav file.wav] [--profile [file.json]] [--trace file [--trace-size 1048576]] [--dump [file.pbm]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /* the instance is large (memory and decode cache) */
+    auto emulator = std::make_unique<emu::Chip8>();
+
+    /* emulation default settings */
+    auto& settings = emulator->settings();
+    settings.m_speed = 500;
+
+    long frames = 600;
+    InputScript input;
+    bool dump = false;
+    std::string dump_path;
+    std::string save_path;
+    std::unique_ptr<emu::Rewind> rewind;
+    const char* quirks = nullptr;
+    const char* speed = nullptr;
+    const char* core = nullptr;
+    std::string load_path;
+    emu::uint32 seed = 0;
+    bool seeded = false;
+    std::string record_path;
+    emu::InputLog log;
+    bool replay = false;
+    detail::WavWriter wav;
+    std::string wav_path;
+    bool profile = false;
+    std::string profile_path;
+    std::string trace_path;
+    std::size_t trace_size = 1 << 20;
+
+    /* load rom */
+    if(!emulator->load_rom(argv[1]))
+    {
+        std::cerr << "[chip-8-headless] Couldn't load rom file: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /* parse options */
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if(arg == "--quirks" && i + 1 < argc)
+        {
+            quirks = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--speed" && i + 1 < argc)
+        {
+            speed = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--core" && i + 1 < argc)
+        {
+            core = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--frames" && i + 1 < argc)
+        {
+            frames = std::abs(std::atol(argv[i+1]));
+
+            i++;
+        }
+        else if(arg == "--input" && i + 1 < argc)
+        {
+            if(!input.load(argv[i+1]))
+            {
+                std::cerr << "[chip-8-headless] Couldn't load input script: " << argv[i+1] << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            i++;
+        }
+        else if(arg == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<emu::uint32>(std::strtoul(argv[i+1], nullptr, 0));
+            seeded = true;
+
+            i++;
+        }
+        else if(arg == "--record" && i + 1 < argc)
+        {
+            record_path = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--replay" && i + 1 < argc)
+        {
+            if(!log.load(argv[i+1]))
+            {
+                std::cerr << "[chip-8-headless] Couldn't load input log: " << argv[i+1] << std::endl;
+                return EXIT_FAILURE;
+            }
+            replay = true;
+
+            i++;
+        }
+        else if(arg == "--no-idle-skip")
+        {
+            settings.m_idle_skip = false;
+        }
+        else if(arg == "--load-state" && i + 1 < argc)
+        {
+            load_path = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--save-state" && i + 1 < argc)
+        {
+            save_path = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--rewind")
+        {
+            rewind = std::make_unique<emu::Rewind>();
+        }
+        else if(arg == "--wav" && i + 1 < argc)
+        {
+            wav_path = argv[i+1];
+            if(!wav.open(wav_path))
+            {
+                std::cerr << "[chip-8-headless] Couldn't write audio: " << wav_path << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            i++;
+        }
+        else if(arg == "--profile")
+        {
+            profile = true;
+            if(!emu::Chip8::profiling) std::cerr << "[chip-8-headless] Built without CHIP8_PROFILE, no profile is recorded." << std::endl;
+
+            /* optional json path */
+            if(i + 1 < argc && std::string(argv[i+1]).rfind("--", 0) != 0)
+            {
+                profile_path = argv[i+1];
+                i++;
+            }
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            trace_path = argv[i+1];
+
+            i++;
+        }
+        else if(arg == "--trace-size" && i + 1 < argc)
+        {
+            trace_size = std::max(1ull, std::strtoull(argv[i+1], nullptr, 0));
+
+            i++;
+        }
+        else if(arg == "--dump")
+        {
+            dump = true;
+
+            /* optional image path */
+            if(i + 1 < argc && std::string(argv[i+1]).rfind("--", 0) != 0)
+            {
+                dump_path = argv[i+1];
+                i++;
+            }
+        }
+        else
+        {
+            std::cerr << "[chip-8-headless] Unknown option: " << arg << std::endl;
+        }
+    }
+
+    /* the save state replaces the settings, explicit options are applied on top of it */
+    if(!load_path.empty() && !emulator->load_state(std::filesystem::path(load_path)))
+    {
+        std::cerr << "[chip-8-headless] Couldn't load save state: " << load_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(quirks)
+    {
+        const std::string options(quirks);
+        settings.m_jumping = options.find('j') != std::string::npos;
+        settings.m_memory = options.find('m') != std::string::npos;
+        settings.m_shifting = options.find('s') != std::string::npos;
+        settings.m_vf_reset = options.find('r') != std::string::npos;
+    }
+
+    if(speed) settings.m_speed = std::max(1, std::abs(std::atoi(speed)));
+
+    if(core)
+    {
+        const std::string name(core);
+        if(name == "table") settings.m_core = emu::Chip8::CORE_TABLE;
+        if(name == "threaded") settings.m_core = emu::Chip8::CORE_THREADED;
+        if(name == "jit") settings.m_core = emu::Chip8::CORE_JIT;
+        if(name == "aot") settings.m_core = emu::Chip8::CORE_AOT;
+    }
+
+    if(!trace_path.empty())
+    {
+        auto trace = std::make_unique<emu::Trace>(std::filesystem::path(trace_path), trace_size);
+        if(!trace->valid())
+        {
+            std::cerr << "[chip-8-headless] Couldn't create trace file: " << trace_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        emulator->trace(std::move(trace));
+    }
+
+    /* replay takes seed and settings from the log, a recording stores them;
+     * a save state carries the generator, so a resumed run is only reseeded by --seed or --record */
+    if(seeded || !record_path.empty() || load_path.empty()) emulator->seed(seed);
+    if(replay) log.prepare(*emulator);
+    if(!record_path.empty()) log.begin(*emulator, seed);
+
+    /* run as fast as possible (no frame limiter) */
+    emu::Synth synth;
+    emu::Synth::Block block;
+    std::size_t cursor = 0;
+    long waited = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(long frame = 0; frame < frames; frame++)
+    {
+        /* FX0A without a pressed key: jump to the next input event (the rewind buffer and the audio need every frame) */
+        if(emulator->waiting() && !rewind && !wav.is_open())
+        {
+            const emu::uint64 next = replay ? log.next(cursor) : input.next(cursor);
+            const auto skipped = static_cast<long>(emulator->fast_forward(std::min<emu::uint64>(next, frames) - frame));
+            frame += skipped;
+            waited += skipped;
+            if(frame == frames) break;
+        }
+
+        if(replay)
+        {
+            log.tick(frame, *emulator, cursor);
+        }
+        else
+        {
+            input.apply(static_cast<emu::uint32>(frame), emulator->keypad(), cursor);
+            if(!record_path.empty()) log.record(frame, 0, *emulator);
+            emulator->tick();
+        }
+        if(rewind) rewind->record(*emulator);
+
+        if(wav.is_open())
+        {
+            synth.tick(*emulator, block);
+            wav.write(block);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double instructions = double(emulator->instructions());
+    std::cout << "frames: " << frames << "  instructions: " << static_cast<emu::uint64>(instructions)
+              << "  idle: " << emulator->idle_cycles() << "  waited: " << waited << " frames"
+              << "  time: " << seconds << "s  (" << (seconds > 0.0 ? instructions / seconds / 1e6 : 0.0) << " MIPS)" << std::endl;
+
+    if(rewind) std::cout << *rewind;
+
+    if(!record_path.empty() && !log.save(record_path))
+    {
+        std::cerr << "[chip-8-headless] Couldn't write input log: " << record_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(profile && emulator->profile())
+    {
+        if(profile_path.empty())
+        {
+            emulator->profile()->report(std::cout);
+        }
+        else
+        {
+            std::ofstream file(profile_path);
+            emulator->profile()->json(file);
+            if(!file)
+            {
+                std::cerr << "[chip-8-headless] Couldn't write profile: " << profile_path << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if(wav.is_open() && !wav.finish())
+    {
+        std::cerr << "[chip-8-headless] Couldn't write audio: " << wav_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(!save_path.empty() && !emulator->save_state(std::filesystem::path(save_path)))
+    {
+        std::cerr << "[chip-8-headless] Couldn't write save state: " << save_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if(dump)
+    {
+        std::cout << "display: " << std::hex << std::setfill('0') << std::setw(16) << emu::hash(emulator->display())
+                  << std::dec << std::setfill(' ') << "\n";
+        detail::print_registers(std::cout, emulator->regs());
+
+        if(!dump_path.empty() && !detail::write_pbm(dump_path, emulator->display()))
+        {
+            std::cerr << "[chip-8-headless] Couldn't write image: " << dump_path << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
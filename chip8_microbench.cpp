@@ -0,0 +1,277 @@
+#include "chip8/chip8.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Chip 8 opcode micro benchmark:
+ * ---------------------------
+ *  -> one synthetic program per detail::eCode (plus DXYN with several heights and FX55/FX65 with several x)
+ *  -> a program is a short preamble (registers, keys) followed by a loop of the same instruction
+ *     (64 copies and a jump back, so the loop jump is amortized; FX1E, FX55 and FX65 reload I once per pass)
+ *  -> timed through Chip8::execute_cycle(): warmup samples are dropped, every sample runs a fixed number of
+ *     instructions; median, p99 and minimum ns per instruction are reported
+ *
+ * arguments:
+ *      chip-8-microbench [--samples 101] [--warmup 10] [--iterations 10000] [--quirks jmsr] [--filter DXYN] [--format table|csv]
+ *
+ *      --samples: timed samples per benchmark (default 101)
+ *      --warmup: untimed samples before measuring (default 10)
+ *      --iterations: instructions per sample (default 10000)
+ *      --filter: only run benchmarks whose name contains the string
+ */
+namespace detail
+{
+
+/* program builder (code starts at Chip8::start_addr) */
+struct Program
+{
+    std::vector<emu::uint8> m_code;
+
+    emu::uint16 here() const { return emu::Chip8::start_addr + static_cast<emu::uint16>(m_code.size()); }
+
+    Program& op(emu::uint16 op_code)
+    {
+        m_code.push_back(op_code >> 8);
+        m_code.push_back(op_code & 0xFF);
+        return *this;
+    }
+
+    /* count copies of op_code followed by a jump back to the first copy */
+    Program& loop(emu::uint16 op_code, int count = 64)
+    {
+        const auto start = here();
+        for(int i = 0; i < count; i++) op(op_code);
+        return op(0x1000 | start);
+    }
+
+    /* like loop(), but every pass starts with head (resets state the copies advance, e.g. I with the memory quirk) */
+    Program& loop(emu::uint16 head, emu::uint16 op_code, int count)
+    {
+        const auto start = here();
+        op(head);
+        for(int i = 0; i < count; i++) op(op_code);
+        return op(0x1000 | start);
+    }
+};
+
+struct Benchmark
+{
+    std::string m_name;
+    std::string m_description;
+    Program m_program;
+    std::function<void(emu::Chip8&)> m_setup;   /* optional (keys) */
+};
+
+std::vector<Benchmark> benchmarks()
+{
+    std::vector<Benchmark> list;
+
+    const auto add = [&](const std::string& name, const std::string& description, Program program, std::function<void(emu::Chip8&)> setup = nullptr)
+    {
+        list.push_back({ name, description, std::move(program), std::move(setup) });
+    };
+
+    add("00E0", "clear screen", Program().loop(0x00E0));
+
+    /* call / return pairs: a call to a subroutine that returns immediately */
+    {
+        Program program;
+        const auto start = program.here();
+        for(int i = 0; i < 32; i++) program.op(0x2000 | (start + 66));
+        program.op(0x1000 | start);
+        program.op(0x00EE);
+        add("2NNN+00EE", "call and return (alternating)", program);
+    }
+
+    /* jump chains: every instruction jumps to the next one */
+    {
+        Program program;
+        const auto start = program.here();
+        for(int i = 1; i < 64; i++) program.op(0x1000 | (start + 2 * i));
+        program.op(0x1000 | start);
+        add("1NNN", "jump to next instruction", program);
+    }
+    {
+        Program program;
+        program.op(0x6000);
+        const auto start = program.here();
+        for(int i = 1; i < 64; i++) program.op(0xB000 | (start + 2 * i));
+        program.op(0xB000 | start);
+        add("BNNN", "jump V0 + NNN to next instruction", program);
+    }
+
+    /* skips are not taken (linear instruction stream) */
+    add("3XNN", "skip if V0 == 01 (not taken)", Program().op(0x6000).loop(0x3001));
+    add("4XNN", "skip if V0 != 00 (not taken)", Program().op(0x6000).loop(0x4000));
+    add("5XY0", "skip if V0 == V1 (not taken)", Program().op(0x6000).op(0x6101).loop(0x5010));
+    add("9XY0", "skip if V0 != V1 (not taken)", Program().op(0x6000).op(0x6100).loop(0x9010));
+    add("EX9E", "skip if key V0 pressed (not taken)", Program().op(0x6000).loop(0xE09E));
+    add("EXA1", "skip if key V0 not pressed (not taken)", Program().op(0x6000).loop(0xE0A1),
+        [](emu::Chip8& chip8) { chip8.keypad()[0] = true; });
+
+    add("6XNN", "load V0", Program().loop(0x6042));
+    add("7XNN", "add to V0", Program().loop(0x7003));
+
+    /* register chains (each result feeds the next instruction) */
+    add("8XY0", "V0 = V1", Program().op(0x6155).loop(0x8010));
+    add("8XY1", "V0 |= V1", Program().op(0x6155).loop(0x8011));
+    add("8XY2", "V0 &= V1", Program().op(0x6155).loop(0x8012));
+    add("8XY3", "V0 ^= V1", Program().op(0x6155).loop(0x8013));
+    add("8XY4", "V0 += V1 with carry", Program().op(0x6155).loop(0x8014));
+    add("8XY5", "V0 -= V1 with borrow", Program().op(0x6155).loop(0x8015));
+    add("8XY6", "V0 = V1 >> 1", Program().op(0x6155).loop(0x8016));
+    add("8XY7", "V0 = V1 - V0 with borrow", Program().op(0x6155).loop(0x8017));
+    add("8XYE", "V0 = V1 << 1", Program().op(0x6155).loop(0x801E));
+
+    add("ANNN", "load I", Program().loop(0xA300));
+    add("CXNN", "random", Program().loop(0xC0FF));
+
+    /* sprites from the font (I = 0), drawn at (V0, V1) = (4, 4) */
+    for(int n : { 1, 5, 8, 15 })
+    {
+        add("DXYN/" + std::to_string(n), "draw 8x" + std::to_string(n) + " sprite",
+            Program().op(0x6004).op(0x6104).op(0xA000).loop(0xD010 | n));
+    }
+
+    add("FX07", "V0 = delay timer", Program().loop(0xF007));
+    add("FX0A", "wait for key (no key pressed)", Program().op(0xF00A));
+    add("FX15", "delay timer = V0", Program().loop(0xF015));
+    add("FX18", "sound timer = V0", Program().loop(0xF018));
+    add("FX1E", "I += V0", Program().op(0x6001).loop(0xA000, 0xF01E, 64));
+    add("FX29", "I = font of V0", Program().op(0x6007).loop(0xF029));
+    add("FX33", "store BCD of V0 at I", Program().op(0x60FE).op(0xA600).loop(0xF033));
+
+    /* I is reloaded every pass, with the memory quirk the copies advance it by x + 1 (at most 0x600 + 64 * 16) */
+    for(int x : { 0x0, 0x7, 0xF })
+    {
+        add("FX55/" + std::to_string(x), "store V0..V" + std::to_string(x) + " at I", Program().loop(0xA600, 0xF055 | (x << 8), 64));
+        add("FX65/" + std::to_string(x), "load V0..V" + std::to_string(x) + " from I", Program().loop(0xA600, 0xF065 | (x << 8), 64));
+    }
+
+#ifdef NDEBUG
+    /* the unknown handler asserts in debug builds */
+    add("UNKNOWN", "unknown opcode 8XY8 (stalls)", Program().op(0x8008));
+#endif
+
+    return list;
+}
+
+struct Options
+{
+    int m_samples = 101;
+    int m_warmup = 10;
+    int m_iterations = 10000;
+    bool m_csv = false;
+    std::string m_filter;
+    emu::Chip8::Settings m_settings;
+};
+
+struct Result
+{
+    double m_median = 0.0;
+    double m_p99 = 0.0;
+    double m_min = 0.0;
+};
+
+Result run(const Options& options, const Benchmark& benchmark)
+{
+    auto chip8 = std::make_unique<emu::Chip8>();
+    chip8->settings() = options.m_settings;
+    chip8->load_rom(benchmark.m_program.m_code);
+    if(benchmark.m_setup) benchmark.m_setup(*chip8);
+
+    std::vector<double> samples;
+    for(int s = 0; s < options.m_warmup + options.m_samples; s++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < options.m_iterations; i++)
+        {
+            chip8->execute_cycle();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if(s >= options.m_warmup) samples.push_back(1e9 * seconds / options.m_iterations);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.m_median = samples[samples.size() / 2];
+    result.m_p99 = samples[std::min(samples.size() - 1, static_cast<std::size_t>(samples.size() * 0.99))];
+    result.m_min = samples.front();
+    return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    detail::Options options;
+
+    /* parse options */
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        const bool value = i + 1 < argc;
+
+        if(arg == "--samples" && value) options.m_samples = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--warmup" && value) options.m_warmup = std::max(0, std::atoi(argv[++i]));
+        else if(arg == "--iterations" && value) options.m_iterations = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--filter" && value) options.m_filter = argv[++i];
+        else if(arg == "--format" && value) options.m_csv = std::string(argv[++i]) == "csv";
+        else if(arg == "--quirks" && value)
+        {
+            std::string quirks(argv[++i]);
+            for(char o : quirks)
+            {
+                switch (o)
+                {
+                    case 'j': options.m_settings.m_jumping = true; break;
+                    case 'm': options.m_settings.m_memory = true; break;
+                    case 's': options.m_settings.m_shifting = true; break;
+                    case 'r': options.m_settings.m_vf_reset = true; break;
+                default: break;
+                }
+            }
+        }
+        else
+        {
+            std::cerr << "[chip-8-microbench] Unknown option: " << arg << std::endl;
+            std::cerr << "                    Usage: chip-8-microbench [--samples 101] [--warmup 10] [--iterations 10000] [--quirks jmsr] [--filter DXYN] [--format table|csv]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(options.m_csv) std::cout << "benchmark,description,median_ns,p99_ns,min_ns\n";
+    else std::cout << std::left << std::setw(12) << "benchmark" << std::setw(40) << "description" << std::right
+                   << std::setw(12) << "median ns" << std::setw(12) << "p99 ns" << std::setw(12) << "min ns" << "\n";
+
+    for(const auto& benchmark : detail::benchmarks())
+    {
+        if(benchmark.m_name.find(options.m_filter) == std::string::npos) continue;
+
+        const auto result = detail::run(options, benchmark);
+
+        std::cout << std::fixed << std::setprecision(2);
+        if(options.m_csv)
+        {
+            std::cout << benchmark.m_name << ",\"" << benchmark.m_description << "\"," << result.m_median << "," << result.m_p99 << "," << result.m_min << "\n";
+        }
+        else
+        {
+            std::cout << std::left << std::setw(12) << benchmark.m_name << std::setw(40) << benchmark.m_description << std::right
+                      << std::setw(12) << result.m_median << std::setw(12) << result.m_p99 << std::setw(12) << result.m_min << "\n";
+        }
+        std::cout << std::defaultfloat << std::flush;
+    }
+
+    return EXIT_SUCCESS;
+}
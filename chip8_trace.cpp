@@ -0,0 +1,78 @@
+#include "chip8/trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Chip 8 trace decoder:
+ * ---------------------------
+ *  -> prints an execution trace (--trace of chip-8-emu and chip-8-headless, see chip8/trace.h) as text, oldest first
+ *  -> one line per instruction: cycle, PC, opcode, I after it and the V register it changed
+ *     ("+": more than one register changed, e.g. VF of 8XY4)
+ *
+ * arguments:
+ *      chip-8-trace <path> [--last 100] [--pc 0x200]
+ *
+ *      <path>: trace file
+ *
+ *      --last: only the newest records
+ *
+ *      --pc: only the records of one address
+ */
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << "[chip-8-trace] Missing trace file." << std::endl;
+        std::cerr << "               Usage: " << "chip-8-trace " << "<path> [--last 100] [--pc 0x200]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::size_t last = 0;
+    long pc = -1;
+
+    /* parse options */
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+
+        if(arg == "--last" && i + 1 < argc)
+        {
+            last = std::strtoull(argv[i+1], nullptr, 0);
+
+            i++;
+        }
+        else if(arg == "--pc" && i + 1 < argc)
+        {
+            pc = std::strtol(argv[i+1], nullptr, 0);
+
+            i++;
+        }
+        else
+        {
+            std::cerr << "[chip-8-trace] Unknown option: " << arg << std::endl;
+        }
+    }
+
+    std::vector<emu::Trace::Record> records;
+    if(!emu::Trace::load(argv[1], records))
+    {
+        std::cerr << "[chip-8-trace] Couldn't read trace file: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::size_t first = last > 0 && last < records.size() ? records.size() - last : 0;
+    std::cout << "# " << records.size() - first << " of " << records.size() << " records\n"
+              << "#      cycle    PC    op  I       change\n";
+
+    for(std::size_t i = first; i < records.size(); i++)
+    {
+        if(pc >= 0 && records[i].m_pc != pc) continue;
+        emu::Trace::print(std::cout, records[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
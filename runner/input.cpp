@@ -0,0 +1,78 @@
+#include "input.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+bool InputScript::load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        std::cerr << "[InputScript::load] Script " + path.string() + " not found!" << std::endl;
+        return false;
+    }
+
+    return parse(file);
+}
+
+bool InputScript::parse(std::istream& stream)
+{
+    m_events.clear();
+
+    std::string line;
+    for(int number = 1; std::getline(stream, line); number++)
+    {
+        /* strip comments */
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream tokens(line);
+        std::string frame, key, state;
+        if(!(tokens >> frame)) continue;
+
+        try
+        {
+            tokens >> key >> state;
+
+            Event event;
+            event.m_frame = static_cast<emu::uint32>(std::stoul(frame));
+            event.m_key = static_cast<emu::uint8>(std::stoul(key, nullptr, 16));
+
+            if(key.size() != 1 || event.m_key >= emu::Chip8::COUNT) throw std::invalid_argument("key");
+            if(state != "down" && state != "up") throw std::invalid_argument("state");
+
+            event.m_down = state == "down";
+            m_events.push_back(event);
+        }
+        catch(const std::exception&)
+        {
+            std::cerr << "[InputScript::parse] Invalid event in line " << number << ": " << line << std::endl;
+            return false;
+        }
+    }
+
+    /* keep the order of events within a frame */
+    std::stable_sort(m_events.begin(), m_events.end(), [](const Event& a, const Event& b) { return a.m_frame < b.m_frame; });
+    return true;
+}
+
+void InputScript::apply(emu::uint32 frame, emu::Chip8::Keypad& keypad, std::size_t& cursor) const
+{
+    for(; cursor < m_events.size() && m_events[cursor].m_frame <= frame; cursor++)
+    {
+        keypad[m_events[cursor].m_key] = m_events[cursor].m_down;
+    }
+}
+
+emu::uint32 InputScript::next(std::size_t cursor) const
+{
+    return cursor < m_events.size() ? m_events[cursor].m_frame : ~emu::uint32(0);
+}
+
+const std::vector<InputScript::Event>& InputScript::events() const
+{
+    return m_events;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chip8/chip8.h>
+
+#include <filesystem>
+#include <istream>
+#include <vector>
+
+/*
+ * Input Script
+ *  -> scripted keypad input for unattended runs (runner, headless)
+ *  -> events are applied at the start of a frame (before Chip8::tick)
+ *
+ *  Format:
+ *  ---------------------------------
+ *    one event per line: <frame> <key> <down|up>
+ *      frame: frame number (0 is the first tick)
+ *      key:   chip8 key as hex digit (0 - F)
+ *    empty lines and everything after '#' are ignored
+ *
+ *    # press 5 for ten frames
+ *    120 5 down
+ *    130 5 up
+ *  ---------------------------------
+ */
+class InputScript
+{
+public:
+    struct Event
+    {
+        emu::uint32 m_frame;
+        emu::uint8 m_key;
+        bool m_down;
+    };
+
+public:
+    /* load script from file (replaces all events) */
+    bool load(const std::filesystem::path& path);
+
+    /* parse script from stream (replaces all events) */
+    bool parse(std::istream& stream);
+
+    /* apply the events of frame to keypad; cursor is the index of the next event (start with 0, frames in increasing order) */
+    void apply(emu::uint32 frame, emu::Chip8::Keypad& keypad, std::size_t& cursor) const;
+
+    /* frame of the next event to apply (~0 if there is none; lets a waiting Chip8 fast forward) */
+    emu::uint32 next(std::size_t cursor) const;
+
+    /* events sorted by frame */
+    const std::vector<Event>& events() const;
+
+private:
+    std::vector<Event> m_events;
+};
@@ -0,0 +1,184 @@
+#include "runner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+Runner::Runner(unsigned int threads)
+    : m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    for(unsigned int i = 0; i < m_threads; i++)
+    {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+std::vector<Runner::Result> Runner::run(const std::vector<Job>& jobs)
+{
+    std::vector<Result> results(jobs.size());
+
+    m_report = Report();
+    m_report.m_workers.resize(m_threads);
+
+    /* contiguous chunks per worker (neighbouring jobs often share rom and settings) */
+    const std::size_t chunk = (jobs.size() + m_threads - 1) / m_threads;
+    for(unsigned int i = 0; i < m_threads; i++)
+    {
+        auto& queue = m_queues[i]->m_jobs;
+        queue.clear();
+
+        for(std::size_t job = i * chunk; job < std::min(jobs.size(), (i + 1) * chunk); job++)
+        {
+            queue.push_back(job);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < m_threads; i++)
+    {
+        workers.emplace_back(&Runner::work, this, i, std::cref(jobs), std::ref(results));
+    }
+
+    /* calling thread is worker 0 */
+    work(0, jobs, results);
+
+    for(auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    m_report.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for(const auto& worker : m_report.m_workers)
+    {
+        m_report.m_cycles += worker.m_cycles;
+    }
+
+    return results;
+}
+
+unsigned int Runner::threads() const
+{
+    return m_threads;
+}
+
+const Runner::Report& Runner::report() const
+{
+    return m_report;
+}
+
+Runner::Result Runner::execute(const Job& job)
+{
+    Result result;
+
+    /* the instance is large (memory and decode cache), keep it off the worker stack */
+    auto chip8 = std::make_unique<emu::Chip8>();
+    chip8->settings() = job.m_settings;
+    chip8->seed(job.m_seed);
+
+    result.m_loaded = job.m_rom && chip8->load_rom(*job.m_rom);
+    if(!result.m_loaded) return result;
+
+    std::size_t cursor = 0;
+    for(emu::uint32 frame = 0; frame < job.m_frames; frame++)
+    {
+        /* nothing happens while FX0A waits until the next scripted event */
+        if(chip8->waiting())
+        {
+            const auto next = std::min(job.m_input ? job.m_input->next(cursor) : job.m_frames, job.m_frames);
+            frame += static_cast<emu::uint32>(chip8->fast_forward(next - frame));
+            if(frame == job.m_frames) break;
+        }
+
+        if(job.m_input) job.m_input->apply(frame, chip8->keypad(), cursor);
+        chip8->tick();
+    }
+
+    result.m_display = chip8->display();
+    result.m_registers = chip8->regs();
+    result.m_cycles = chip8->instructions();
+    return result;
+}
+
+void Runner::work(unsigned int worker, const std::vector<Job>& jobs, std::vector<Result>& results)
+{
+    Report::Worker stats;
+
+    std::size_t job;
+    for(;;)
+    {
+        if(!pop(worker, job))
+        {
+            if(!steal(worker, job)) break;
+            stats.m_stolen++;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        /* each job writes only its own result slot */
+        results[job] = execute(jobs[job]);
+        results[job].m_worker = worker;
+
+        stats.m_busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.m_cycles += results[job].m_cycles;
+        stats.m_jobs++;
+    }
+
+    m_report.m_workers[worker] = stats;
+}
+
+bool Runner::pop(unsigned int worker, std::size_t& job)
+{
+    auto& queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+    if(queue.m_jobs.empty()) return false;
+
+    job = queue.m_jobs.back();
+    queue.m_jobs.pop_back();
+    return true;
+}
+
+bool Runner::steal(unsigned int worker, std::size_t& job)
+{
+    for(unsigned int i = 1; i < m_threads; i++)
+    {
+        auto& queue = *m_queues[(worker + i) % m_threads];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+        if(queue.m_jobs.empty()) continue;
+
+        job = queue.m_jobs.front();
+        queue.m_jobs.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+std::ostream& operator<<(std::ostream& stream, const Runner::Report& report)
+{
+    const auto mips = [](emu::uint64 cycles, double seconds) { return seconds > 0.0 ? cycles / seconds / 1e6 : 0.0; };
+
+    stream << "+---------------------------[Runner]-----------------------------+\n";
+    for(std::size_t i = 0; i < report.m_workers.size(); i++)
+    {
+        const auto& worker = report.m_workers[i];
+        stream << " [worker " << std::setw(2) << i << "]: "
+               << std::setw(6) << worker.m_jobs << " jobs ("
+               << std::setw(4) << worker.m_stolen << " stolen)  "
+               << std::fixed << std::setprecision(1) << std::setw(8) << mips(worker.m_cycles, worker.m_busy) << " MIPS  "
+               << std::setw(5) << (report.m_seconds > 0.0 ? 100.0 * worker.m_busy / report.m_seconds : 0.0) << "% busy\n";
+    }
+
+    const auto threads = std::max<std::size_t>(1, report.m_workers.size());
+    stream << " [total]: " << report.m_cycles << " instructions in " << std::setprecision(3) << report.m_seconds << "s\n"
+           << "          " << std::setprecision(1) << mips(report.m_cycles, report.m_seconds) << " MIPS, "
+           << mips(report.m_cycles, report.m_seconds) / threads << " MIPS per core\n";
+    stream << "+----------------------------------------------------------------+\n";
+    stream << std::defaultfloat;
+
+    return stream;
+}
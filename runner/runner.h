@@ -0,0 +1,99 @@
+#pragma once
+
+#include "input.h"
+
+#include <chip8/chip8.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/*
+ * Multi-Instance Runner
+ *  -> runs batches of independent Chip8 jobs (rom, settings, input script, frame count) on a work-stealing thread pool
+ *  -> every job gets its own Chip8 instance; no mutable state is shared between instances
+ *     (the CXNN random generator is per instance and seeded from the job)
+ *  -> rom data and input scripts are shared read-only between jobs
+ *  -> results are stored by job index (final framebuffer, registers and executed cycles)
+ *
+ *  Scheduling:
+ *  ---------------------------------
+ *    - jobs are split into contiguous chunks, one deque per worker
+ *    - a worker pops jobs from the back of its own deque
+ *    - an idle worker steals from the front of the other deques
+ *    - workers are started per run() and exit once all deques are empty (jobs never spawn jobs)
+ *  ---------------------------------
+ */
+class Runner
+{
+public:
+    struct Job
+    {
+        std::shared_ptr<const std::vector<emu::uint8>> m_rom;
+        emu::Chip8::Settings m_settings;
+        std::shared_ptr<const InputScript> m_input;     /* optional */
+        emu::uint32 m_frames = 60;
+        emu::uint32 m_seed = 0;
+    };
+
+    struct Result
+    {
+        bool m_loaded = false;
+        emu::Chip8::Display m_display = {};
+        emu::Chip8::Registers m_registers = {};
+        emu::uint64 m_cycles = 0;                       /* instructions executed (Chip8::instructions) */
+        unsigned int m_worker = 0;                      /* worker that executed the job */
+    };
+
+    /* throughput of the last run */
+    struct Report
+    {
+        struct Worker
+        {
+            emu::uint64 m_jobs = 0;
+            emu::uint64 m_stolen = 0;
+            emu::uint64 m_cycles = 0;
+            double m_busy = 0.0;                        /* seconds spent executing jobs */
+        };
+
+        std::vector<Worker> m_workers;
+        emu::uint64 m_cycles = 0;
+        double m_seconds = 0.0;                         /* wall clock time of run() */
+    };
+
+public:
+    /* threads = 0: one worker per hardware thread */
+    explicit Runner(unsigned int threads = 0);
+
+    /* execute all jobs (blocks until done) */
+    std::vector<Result> run(const std::vector<Job>& jobs);
+
+    unsigned int threads() const;
+    const Report& report() const;
+
+    /* execute a single job on the calling thread */
+    static Result execute(const Job& job);
+
+private:
+    struct Queue
+    {
+        std::mutex m_mutex;
+        std::deque<std::size_t> m_jobs;
+    };
+
+    void work(unsigned int worker, const std::vector<Job>& jobs, std::vector<Result>& results);
+
+    /* next job index from the back of the own queue / the front of another queue */
+    bool pop(unsigned int worker, std::size_t& job);
+    bool steal(unsigned int worker, std::size_t& job);
+
+private:
+    unsigned int m_threads;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    Report m_report;
+};
+
+/* per worker and total throughput */
+std::ostream& operator<< (std::ostream& stream, const Runner::Report& report);
@@ -0,0 +1,33 @@
+#########################################
+#   Cross-core check: a rom ends in the #
+#   same display and registers on every #
+#   execution core                      #
+#---------------------------------------#
+# cmake -D HEADLESS=chip-8-headless     #
+#       -D ROM=rom.ch8 [-D QUIRKS=jmsr] #
+#       [-D FRAMES=600]                 #
+#       [-D AOT=chip-8-aot-<rom>]       #
+#       -P tests/cross_core.cmake       #
+#########################################
+include( "${CMAKE_CURRENT_LIST_DIR}/headless.cmake" )
+
+if( NOT FRAMES )
+    set( FRAMES 600 )
+endif()
+
+set( ARGS "${ROM}" --frames ${FRAMES} --dump )
+if( QUIRKS )
+    list( APPEND ARGS --quirks ${QUIRKS} )
+endif()
+
+run_headless( TABLE "${HEADLESS}" ${ARGS} --core table )
+run_headless( THREADED "${HEADLESS}" ${ARGS} --core threaded )
+run_headless( JIT "${HEADLESS}" ${ARGS} --core jit )
+expect_same( table "${TABLE}" threaded "${THREADED}" )
+expect_same( table "${TABLE}" jit "${JIT}" )
+
+# without the translation linked in, --core aot runs the threaded core
+if( AOT )
+    run_headless( AOT_RUN "${AOT}" ${ARGS} --core aot )
+    expect_same( table "${TABLE}" aot "${AOT_RUN}" )
+endif()
@@ -0,0 +1,27 @@
+#########################################
+#   Helpers of the chip-8-headless      #
+#   checks (included by tests/*.cmake)  #
+#########################################
+
+# runs chip-8-headless (or an aot runner) and stores its --dump output in OUT,
+# without the statistics line (timing differs from run to run)
+function( run_headless OUT EXECUTABLE )
+    execute_process( COMMAND "${EXECUTABLE}" ${ARGN}
+        OUTPUT_VARIABLE RUN_OUTPUT
+        ERROR_VARIABLE RUN_ERROR
+        RESULT_VARIABLE RUN_RESULT )
+
+    if( NOT RUN_RESULT EQUAL 0 )
+        message( FATAL_ERROR "${EXECUTABLE} ${ARGN} failed (${RUN_RESULT}):\n${RUN_OUTPUT}${RUN_ERROR}" )
+    endif()
+
+    string( REGEX REPLACE "^frames:[^\n]*\n" "" RUN_OUTPUT "${RUN_OUTPUT}" )
+    set( ${OUT} "${RUN_OUTPUT}" PARENT_SCOPE )
+endfunction()
+
+# fails with both dumps if they differ
+function( expect_same NAME_A A NAME_B B )
+    if( NOT A STREQUAL B )
+        message( FATAL_ERROR "${NAME_A} and ${NAME_B} differ:\n-- ${NAME_A}:\n${A}-- ${NAME_B}:\n${B}" )
+    endif()
+endfunction()
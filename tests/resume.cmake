@@ -0,0 +1,23 @@
+#########################################
+#   Resume check: a run split by        #
+#   --save-state / --load-state ends    #
+#   like the uninterrupted run          #
+#---------------------------------------#
+# cmake -D HEADLESS=chip-8-headless     #
+#       -D ROM=rom.ch8 -D STATE=file    #
+#       [-D FRAMES=300]                 #
+#       -P tests/resume.cmake           #
+#########################################
+include( "${CMAKE_CURRENT_LIST_DIR}/headless.cmake" )
+
+if( NOT FRAMES )
+    set( FRAMES 300 )
+endif()
+math( EXPR TOTAL "${FRAMES} * 2" )
+
+run_headless( FULL "${HEADLESS}" "${ROM}" --frames ${TOTAL} --dump )
+run_headless( FIRST "${HEADLESS}" "${ROM}" --frames ${FRAMES} --save-state "${STATE}" )
+run_headless( RESUMED "${HEADLESS}" "${ROM}" --frames ${FRAMES} --load-state "${STATE}" --dump )
+file( REMOVE "${STATE}" )
+
+expect_same( uninterrupted "${FULL}" resumed "${RESUMED}" )
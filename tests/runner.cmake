@@ -0,0 +1,42 @@
+#########################################
+#   Runner check: the corpus run on the #
+#   work-stealing runner ends in the    #
+#   same displays as the sequential run #
+#---------------------------------------#
+# cmake -D BENCH=chip-8-bench           #
+#       -D ROMS=roms [-D FRAMES=300]    #
+#       [-D THREADS=4]                  #
+#       -P tests/runner.cmake           #
+#########################################
+if( NOT FRAMES )
+    set( FRAMES 300 )
+endif()
+
+if( NOT THREADS )
+    set( THREADS 4 )
+endif()
+
+execute_process( COMMAND "${BENCH}" --roms "${ROMS}" --frames ${FRAMES} --repeat 1
+    OUTPUT_VARIABLE SEQUENTIAL
+    ERROR_QUIET
+    RESULT_VARIABLE RESULT )
+
+if( NOT RESULT EQUAL 0 OR NOT SEQUENTIAL MATCHES "\"TOTAL\",[^,]*,[^,]*,[^,]*,[^,]*,[^,]*,[^,]*,([0-9a-f]+)" )
+    message( FATAL_ERROR "sequential run failed (${RESULT}):\n${SEQUENTIAL}" )
+endif()
+set( EXPECTED "${CMAKE_MATCH_1}" )
+
+execute_process( COMMAND "${BENCH}" --roms "${ROMS}" --frames ${FRAMES} --repeat 2 --threads ${THREADS}
+    OUTPUT_VARIABLE THREADED
+    ERROR_QUIET
+    RESULT_VARIABLE RESULT )
+
+if( NOT RESULT EQUAL 0 OR NOT THREADED MATCHES "display hash: ([0-9a-f]+)" )
+    message( FATAL_ERROR "runner failed (${RESULT}):\n${THREADED}" )
+endif()
+
+if( NOT CMAKE_MATCH_1 STREQUAL EXPECTED )
+    message( FATAL_ERROR "runner display hash ${CMAKE_MATCH_1} differs from the sequential ${EXPECTED}:\n${THREADED}" )
+endif()
+
+message( STATUS "${THREADED}" )
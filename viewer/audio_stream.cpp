@@ -0,0 +1,127 @@
+#include "audio_stream.h"
+
+#include <algorithm>
+
+AudioStream::AudioStream(double bound)
+{
+    initialize(1, emu::Synth::sample_rate);
+    latency_bound(bound);
+}
+
+AudioStream::~AudioStream()
+{
+    /* the streaming thread calls onGetData until it is stopped, before the members go away */
+    stop();
+}
+
+void AudioStream::latency_bound(double seconds)
+{
+    /* the device buffers in front of a tick's chunk are queued anyway, the rest of the bound is backlog */
+    const auto device = (queued_chunks - 1) * chunk_size;
+    const auto bound = static_cast<std::size_t>(std::max(seconds, 0.0) * emu::Synth::sample_rate);
+    const auto ahead = std::max(bound > device ? bound - device : 0, chunk_size);
+
+    m_max_backlog = emu::Synth::samples_per_tick + ahead;
+}
+
+double AudioStream::latency_bound() const
+{
+    const auto ahead = m_max_backlog - emu::Synth::samples_per_tick;
+    return double(ahead + (queued_chunks - 1) * chunk_size) / emu::Synth::sample_rate;
+}
+
+void AudioStream::push(const emu::Synth::Block& block)
+{
+    const auto pushed = m_samples.push(block.data(), block.size());
+    if(pushed < block.size()) m_dropped.fetch_add(block.size() - pushed, std::memory_order_relaxed);
+
+    if(pushed > 0) m_marks.push({ m_written, Scheduler::Clock::now() });
+    m_written += pushed;
+}
+
+bool AudioStream::onGetData(Chunk& data)
+{
+    /* bound the latency: drop the oldest samples of a long backlog */
+    const auto backlog = m_samples.size();
+    if(backlog > m_max_backlog)
+    {
+        const auto skipped = m_samples.skip(backlog - emu::Synth::samples_per_tick / 2);
+        m_dropped.fetch_add(skipped, std::memory_order_relaxed);
+        m_read += skipped;
+    }
+
+    const auto count = m_samples.pop(m_chunk.data(), m_chunk.size());
+    if(count < m_chunk.size())
+    {
+        std::fill(m_chunk.begin() + count, m_chunk.end(), 0);
+        if(m_flowing) m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_flowing = count == m_chunk.size();
+
+    /* ticks starting in this chunk reach the device now, behind the chunks still queued */
+    const auto now = Scheduler::Clock::now();
+    const auto bound = static_cast<std::uint64_t>(latency_bound() * 1e6);
+    for(;;)
+    {
+        if(!m_marked && !(m_marked = m_marks.pop(m_mark))) break;
+        if(m_mark.m_sample >= m_read + count) break;
+
+        if(m_mark.m_sample >= m_read)
+        {
+            const auto queued = (m_mark.m_sample - m_read + (queued_chunks - 1) * chunk_size) * 1000000 / emu::Synth::sample_rate;
+            const auto latency = std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now - m_mark.m_time).count()) + queued;
+
+            m_latency_sum.fetch_add(latency, std::memory_order_relaxed);
+            m_measured.fetch_add(1, std::memory_order_relaxed);
+            if(latency > bound) m_late.fetch_add(1, std::memory_order_relaxed);
+            if(latency > m_latency_max.load(std::memory_order_relaxed)) m_latency_max.store(latency, std::memory_order_relaxed);
+        }
+
+        m_marked = false;
+    }
+    m_read += count;
+
+    data.samples = m_chunk.data();
+    data.sampleCount = m_chunk.size();
+    return true;
+}
+
+void AudioStream::onSeek(sf::Time)
+{
+    /* a live stream has no position to seek to */
+}
+
+double AudioStream::latency() const
+{
+    const auto measured = m_measured.load(std::memory_order_relaxed);
+    return measured > 0 ? m_latency_sum.load(std::memory_order_relaxed) / 1e6 / measured : 0.0;
+}
+
+double AudioStream::max_latency() const
+{
+    return m_latency_max.load(std::memory_order_relaxed) / 1e6;
+}
+
+std::uint64_t AudioStream::late() const
+{
+    return m_late.load(std::memory_order_relaxed);
+}
+
+std::uint64_t AudioStream::underruns() const
+{
+    return m_underruns.load(std::memory_order_relaxed);
+}
+
+std::uint64_t AudioStream::dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+std::ostream& operator<<(std::ostream& stream, const AudioStream& audio)
+{
+    stream << "audio: " << audio.latency() * 1000.0 << " ms latency (max " << audio.max_latency() * 1000.0 << " ms, bound "
+           << audio.latency_bound() * 1000.0 << " ms, " << audio.late() << " ticks above), "
+           << audio.underruns() << " underruns, " << audio.dropped() << " samples dropped\n";
+
+    return stream;
+}
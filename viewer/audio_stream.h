@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chip8/synth.h>
+
+#include "scheduler.h"
+#include "spsc_queue.h"
+
+#include <array>
+#include <atomic>
+#include <ostream>
+
+#include <SFML/Audio/SoundStream.hpp>
+
+/*
+ *  Audio Stream:
+ *  -----------------------------
+ *  -> plays the blocks the emulation thread renders with emu::Synth (one per tick, mono)
+ *  -> samples are handed to SFML's streaming thread through a lock-free SPSC ring,
+ *     push() never waits (samples that do not fit are dropped), an empty ring plays silence (underrun)
+ *  -> the streaming thread pulls chunk_size samples per OpenAL buffer, sf::SoundStream queues queued_chunks of them
+ *  -> latency bound (Viewer::audio_latency()): the audio queued ahead of a tick's first sample, i.e. the backlog of
+ *     earlier ticks plus the queued_chunks - 1 device buffers in front of its chunk, stays below it; a longer backlog
+ *     (after a stall, or the audio device clock drifting from the scheduler) is dropped down to half a tick, oldest
+ *     samples first
+ *  -> the bound is at least the device buffers plus one chunk of backlog (16 ms); sf::SoundStream (SFML 2.5) refills
+ *     the device buffers every 10 ms, so the backlog settles around 20 ms of latency and peaks about 5 ms above,
+ *     the default of 25 ms leaves it room (a tighter bound drops samples while playing steadily)
+ *  -> measures the end-to-end latency of every tick: time from push() to its first sample entering the device
+ *     queue, plus the chunks queued ahead of it
+ *
+ *  -----------------------------
+ */
+class AudioStream : public sf::SoundStream
+{
+public:
+    static constexpr std::size_t chunk_size = 256;      /* 5.3 ms at 48 khz */
+    static constexpr std::size_t queued_chunks = 3;     /* OpenAL buffers of sf::SoundStream */
+    static constexpr double default_latency = 0.025;    /* seconds */
+
+    explicit AudioStream(double bound = default_latency);
+    ~AudioStream() override;
+
+    /* latency bound in seconds (call before play(); rounded up to the smallest bound the buffers allow) */
+    void latency_bound(double seconds);
+    double latency_bound() const;
+
+    /* emulation thread: queue the samples of one tick */
+    void push(const emu::Synth::Block& block);
+
+    double latency() const;                 /* average end-to-end latency in seconds */
+    double max_latency() const;
+    std::uint64_t late() const;             /* ticks measured above the bound */
+    std::uint64_t underruns() const;        /* times the ring ran dry while samples were flowing */
+    std::uint64_t dropped() const;          /* samples dropped (ring full, backlog too long) */
+
+protected:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time offset) override;
+
+private:
+    /* first sample of a pushed tick (index into the ring's sample sequence) and when it was pushed */
+    struct Mark
+    {
+        std::uint64_t m_sample = 0;
+        Scheduler::Clock::time_point m_time;
+    };
+
+    SpscQueue<emu::int16, 4096> m_samples;
+    std::size_t m_max_backlog = 0;          /* samples of earlier ticks allowed ahead of a tick, plus the tick */
+    SpscQueue<Mark, 64> m_marks;
+
+    /* emulation thread */
+    std::uint64_t m_written = 0;            /* samples pushed into the ring */
+
+    /* streaming thread */
+    std::array<emu::int16, chunk_size> m_chunk{};
+    std::uint64_t m_read = 0;               /* samples popped or skipped */
+    Mark m_mark;
+    bool m_marked = false;                  /* m_mark is the next tick to measure */
+    bool m_flowing = false;                 /* the last chunk was full (running dry while idle counts once) */
+
+    std::atomic<std::uint64_t> m_latency_sum{ 0 };     /* microseconds */
+    std::atomic<std::uint64_t> m_latency_max{ 0 };
+    std::atomic<std::uint64_t> m_measured{ 0 };
+    std::atomic<std::uint64_t> m_late{ 0 };
+    std::atomic<std::uint64_t> m_underruns{ 0 };
+    std::atomic<std::uint64_t> m_dropped{ 0 };
+};
+
+/* latency, bound, underruns and dropped samples */
+std::ostream& operator<< (std::ostream& stream, const AudioStream& audio);
@@ -0,0 +1,80 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+Scheduler::Scheduler(double rate, unsigned int max_catch_up)
+    : m_step(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))),
+      m_max_catch_up(std::max(1u, max_catch_up))
+{
+    m_last = m_start = Clock::now();
+}
+
+void Scheduler::reset()
+{
+    const auto now = Clock::now();
+
+    if(m_steps == 0 && m_dropped == 0) m_start = now;
+    else m_paused += now - m_last;
+
+    m_last = now;
+    m_accumulator = Clock::duration::zero();
+}
+
+unsigned int Scheduler::due()
+{
+    const auto now = Clock::now();
+    m_accumulator += now - m_last;
+    m_last = now;
+
+    auto steps = static_cast<std::uint64_t>(m_accumulator / m_step);
+    m_accumulator -= steps * m_step;
+
+    /* too far behind: run the cap, drop the rest */
+    if(steps > m_max_catch_up)
+    {
+        m_dropped += steps - m_max_catch_up;
+        steps = m_max_catch_up;
+    }
+
+    m_steps += steps;
+    return static_cast<unsigned int>(steps);
+}
+
+Scheduler::Clock::time_point Scheduler::next() const
+{
+    return m_last + (m_step - m_accumulator);
+}
+
+void Scheduler::rate(double rate)
+{
+    m_step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+}
+
+double Scheduler::rate() const
+{
+    return 1.0 / std::chrono::duration<double>(m_step).count();
+}
+
+std::uint64_t Scheduler::steps() const
+{
+    return m_steps;
+}
+
+std::uint64_t Scheduler::dropped() const
+{
+    return m_dropped;
+}
+
+double Scheduler::measured_rate() const
+{
+    const double seconds = std::chrono::duration<double>(m_last - m_start - m_paused).count();
+    return seconds > 0.0 ? m_steps / seconds : 0.0;
+}
+
+std::ostream& operator<<(std::ostream& stream, const Scheduler& scheduler)
+{
+    stream << "scheduler: " << scheduler.measured_rate() << " / " << scheduler.rate() << " steps/s, "
+           << scheduler.steps() << " steps, " << scheduler.dropped() << " dropped\n";
+
+    return stream;
+}
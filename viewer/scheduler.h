@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/*
+ *  Fixed Timestep Scheduler:
+ *  -----------------------------
+ *  -> turns wall clock time (steady, high resolution) into a number of fixed size steps
+ *  -> elapsed time is accumulated, due() consumes whole steps and keeps the remainder for the next call,
+ *     so the long-term step rate is exact regardless of how often or how late due() is called
+ *  -> after a stall (slow frame, debugger, suspend) at most max_catch_up steps are run at once,
+ *     the rest of the backlog is dropped (counted) instead of fast-forwarding the game
+ *  -> measures the achieved step rate
+ *
+ *  -----------------------------
+ */
+class Scheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /* rate: steps per second */
+    explicit Scheduler(double rate = 60.0, unsigned int max_catch_up = 5);
+
+    /* restart the clock (nothing is due until one step has elapsed; after sleeping or pausing) */
+    void reset();
+
+    /* steps due since the last call */
+    unsigned int due();
+
+    /* time point the next step is due at (sleep target) */
+    Clock::time_point next() const;
+
+    /* change the step rate (keeps the accumulated time) */
+    void rate(double rate);
+
+    double rate() const;
+    std::uint64_t steps() const;            /* steps handed out by due() */
+    std::uint64_t dropped() const;          /* steps dropped by the catch-up limit */
+    double measured_rate() const;           /* steps per second since the first reset() */
+
+private:
+    Clock::duration m_step;
+    unsigned int m_max_catch_up;
+
+    Clock::time_point m_last;
+    Clock::duration m_accumulator{ 0 };
+
+    Clock::time_point m_start;
+    Clock::duration m_paused{ 0 };          /* time between a reset() and the previous due() (not measured) */
+    std::uint64_t m_steps = 0;
+    std::uint64_t m_dropped = 0;
+};
+
+/* achieved and requested rate, dropped steps */
+std::ostream& operator<< (std::ostream& stream, const Scheduler& scheduler);
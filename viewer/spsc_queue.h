@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/*
+ *  Single Producer Single Consumer Queue:
+ *  -----------------------------
+ *  -> lock-free ring of N elements (power of two), one thread pushes, another one pops
+ *  -> head and tail only grow (wrapped by masking), each is written by one side only
+ *  -> push() fails instead of blocking when the ring is full (the bulk overloads move as many elements as fit)
+ *  -> the consumer can sleep in wait() until the producer pushes (C++20 atomic wait)
+ *
+ *  -----------------------------
+ */
+template<typename T, std::size_t N>
+class SpscQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity has to be a power of two");
+
+public:
+    /* producer: false if the queue is full */
+    bool push(const T& value)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) == N) return false;
+
+        m_data[tail & (N - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+        return true;
+    }
+
+    /* producer: pushes the first values that fit, returns how many */
+    std::size_t push(const T* values, std::size_t count)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        count = std::min(count, N - (tail - m_head.load(std::memory_order_acquire)));
+
+        for(std::size_t i = 0; i < count; i++) m_data[(tail + i) & (N - 1)] = values[i];
+        m_tail.store(tail + count, std::memory_order_release);
+        m_tail.notify_one();
+        return count;
+    }
+
+    /* consumer: false if the queue is empty */
+    bool pop(T& value)
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire)) return false;
+
+        value = m_data[head & (N - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer: pops up to count values, returns how many */
+    std::size_t pop(T* values, std::size_t count)
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        count = std::min(count, m_tail.load(std::memory_order_acquire) - head);
+
+        for(std::size_t i = 0; i < count; i++) values[i] = m_data[(head + i) & (N - 1)];
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /* consumer: drops up to count of the oldest values, returns how many */
+    std::size_t skip(std::size_t count)
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        count = std::min(count, m_tail.load(std::memory_order_acquire) - head);
+
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /* consumer: values in the queue (the producer may add more any moment) */
+    std::size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed);
+    }
+
+    /* consumer: block until the queue is not empty */
+    void wait() const
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        m_tail.wait(head, std::memory_order_acquire);
+    }
+
+private:
+    /* head and tail on separate cache lines (no false sharing between producer and consumer) */
+    alignas(64) std::atomic<std::size_t> m_head = 0;
+    alignas(64) std::atomic<std::size_t> m_tail = 0;
+    alignas(64) std::array<T, N> m_data;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+/*
+ *  Triple Buffer:
+ *  -----------------------------
+ *  -> hands the newest value from one writer thread to one reader thread without locks
+ *  -> three slots: the writer owns one (back), the reader owns one (front), the third is the latest published
+ *  -> publish() swaps back with the middle slot, update() swaps front with the middle slot if it is newer
+ *  -> neither side ever waits; frames the reader did not pick up in time are overwritten
+ *
+ *  -----------------------------
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    /* writer: slot to fill, then publish() it */
+    T& back()
+    {
+        return m_slots[m_back];
+    }
+
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & index;
+    }
+
+    /* writer: the last published value was not picked up yet (it may be any moment, so true is only a hint) */
+    bool pending() const
+    {
+        return m_middle.load(std::memory_order_acquire) & fresh;
+    }
+
+    /* reader: picks up the latest published value; false if there is none since the last call */
+    bool update()
+    {
+        if(!(m_middle.load(std::memory_order_relaxed) & fresh)) return false;
+
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index;
+        return true;
+    }
+
+    const T& front() const
+    {
+        return m_slots[m_front];
+    }
+
+private:
+    /* middle slot index, with a flag set by publish() and cleared by update() */
+    static constexpr unsigned int index = 0x3;
+    static constexpr unsigned int fresh = 0x4;
+
+    std::array<T, 3> m_slots{};
+    unsigned int m_back = 0;
+    unsigned int m_front = 1;
+    std::atomic<unsigned int> m_middle = 2;
+};
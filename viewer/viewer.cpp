@@ -2,8 +2,14 @@
 
 #include "window.h"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <thread>
 
 namespace detail
 {
@@ -18,29 +24,40 @@ struct CBWindow : public Window
 
     void onKey(int key, bool ctrl, bool press) override
     {
-        auto& keypad = m_viewer.emulator().keypad();
+        using Command = Viewer::Command;
+        const bool replay = m_viewer.m_input.m_replay;
 
-        if(!ctrl)
+        if(!ctrl && !replay)
         {
-            if(key == sf::Keyboard::Key::Num1) keypad[emu::Chip8::KEY_1] = press;
-            if(key == sf::Keyboard::Key::Num2) keypad[emu::Chip8::KEY_2] = press;
-            if(key == sf::Keyboard::Key::Num3) keypad[emu::Chip8::KEY_3] = press;
-            if(key == sf::Keyboard::Key::Num4) keypad[emu::Chip8::KEY_C] = press;
-
-            if(key == sf::Keyboard::Key::Q) keypad[emu::Chip8::KEY_4] = press;
-            if(key == sf::Keyboard::Key::W) keypad[emu::Chip8::KEY_5] = press;
-            if(key == sf::Keyboard::Key::E) keypad[emu::Chip8::KEY_6] = press;
-            if(key == sf::Keyboard::Key::R) keypad[emu::Chip8::KEY_D] = press;
-
-            if(key == sf::Keyboard::Key::A) keypad[emu::Chip8::KEY_7] = press;
-            if(key == sf::Keyboard::Key::S) keypad[emu::Chip8::KEY_8] = press;
-            if(key == sf::Keyboard::Key::D) keypad[emu::Chip8::KEY_9] = press;
-            if(key == sf::Keyboard::Key::F) keypad[emu::Chip8::KEY_E] = press;
+            const auto chip8_key = [key]() -> int
+            {
+                switch(key)
+                {
+                case sf::Keyboard::Key::Num1: return emu::Chip8::KEY_1;
+                case sf::Keyboard::Key::Num2: return emu::Chip8::KEY_2;
+                case sf::Keyboard::Key::Num3: return emu::Chip8::KEY_3;
+                case sf::Keyboard::Key::Num4: return emu::Chip8::KEY_C;
+
+                case sf::Keyboard::Key::Q: return emu::Chip8::KEY_4;
+                case sf::Keyboard::Key::W: return emu::Chip8::KEY_5;
+                case sf::Keyboard::Key::E: return emu::Chip8::KEY_6;
+                case sf::Keyboard::Key::R: return emu::Chip8::KEY_D;
+
+                case sf::Keyboard::Key::A: return emu::Chip8::KEY_7;
+                case sf::Keyboard::Key::S: return emu::Chip8::KEY_8;
+                case sf::Keyboard::Key::D: return emu::Chip8::KEY_9;
+                case sf::Keyboard::Key::F: return emu::Chip8::KEY_E;
+
+                case sf::Keyboard::Key::Y:
+                case sf::Keyboard::Key::Z: return emu::Chip8::KEY_A;
+                case sf::Keyboard::Key::X: return emu::Chip8::KEY_0;
+                case sf::Keyboard::Key::C: return emu::Chip8::KEY_B;
+                case sf::Keyboard::Key::V: return emu::Chip8::KEY_F;
+                default: return -1;
+                }
+            }();
 
-            if(key == sf::Keyboard::Key::Y || key == sf::Keyboard::Key::Z) keypad[emu::Chip8::KEY_A] = press;
-            if(key == sf::Keyboard::Key::X) keypad[emu::Chip8::KEY_0] = press;
-            if(key == sf::Keyboard::Key::C) keypad[emu::Chip8::KEY_B] = press;
-            if(key == sf::Keyboard::Key::V) keypad[emu::Chip8::KEY_F] = press;
+            if(chip8_key >= 0) m_viewer.send({ Command::KEY, static_cast<emu::uint8>(chip8_key), press });
         }
 
         /***** emulator controls *****/
@@ -53,7 +70,7 @@ struct CBWindow : public Window
         {
             m_viewer.m_render.m_scale *= 2;
             m_viewer.m_render.m_scale = std::min(m_viewer.m_render.m_scale, 64);
-            m_viewer.m_display_sprite.setScale(m_viewer.m_render.m_scale, m_viewer.m_render.m_scale);
+            m_viewer.m_display_sprite.setScale(m_viewer.m_render.m_scale / 2.0f, m_viewer.m_render.m_scale / 2.0f);
             size(emu::Chip8::width_res * m_viewer.m_render.m_scale, emu::Chip8::height_res * m_viewer.m_render.m_scale);
 
             sf::FloatRect visibleArea(0, 0, emu::Chip8::width_res * m_viewer.m_render.m_scale, emu::Chip8::height_res * m_viewer.m_render.m_scale);
@@ -65,53 +82,44 @@ struct CBWindow : public Window
         {
             m_viewer.m_render.m_scale /= 2;
             m_viewer.m_render.m_scale = std::max(m_viewer.m_render.m_scale, 4);
-            m_viewer.m_display_sprite.setScale(m_viewer.m_render.m_scale, m_viewer.m_render.m_scale);
+            m_viewer.m_display_sprite.setScale(m_viewer.m_render.m_scale / 2.0f, m_viewer.m_render.m_scale / 2.0f);
 
             sf::FloatRect visibleArea(0, 0, emu::Chip8::width_res * m_viewer.m_render.m_scale, emu::Chip8::height_res * m_viewer.m_render.m_scale);
             size(visibleArea.width, visibleArea.height);
             renderWindow().setView(sf::View(visibleArea));
         }
 
-        if(key == sf::Keyboard::Key::Add && press)
+        if(key == sf::Keyboard::Key::Add && press && !replay)
         {
-            auto& cycles = m_viewer.m_emulator.settings().m_cycles;
-            cycles += 1;
+            m_viewer.send({ Command::SPEED, 0, 1 });
         }
 
-        if(key == sf::Keyboard::Key::Subtract && press)
+        if(key == sf::Keyboard::Key::Subtract && press && !replay)
         {
-            auto& cycles = m_viewer.m_emulator.settings().m_cycles;
-            cycles -= 1;
-            cycles = std::max(1, cycles);
+            m_viewer.send({ Command::SPEED, 0, -1 });
         }
 
         if(key == sf::Keyboard::Key::Space && press)
         {
-            std::cout << m_viewer.emulator() << std::endl;
-        }
-
-        if(ctrl && key == sf::Keyboard::Key::J)
-        {
-            auto& setting = m_viewer.emulator().settings().m_jumping;
-            setting = !setting;
+            m_viewer.send({ Command::PRINT });
         }
 
-        if(ctrl && key == sf::Keyboard::Key::S)
+        if(key == sf::Keyboard::Key::Tab && press)
         {
-            auto& setting = m_viewer.emulator().settings().m_shifting;
-            setting = !setting;
+            m_viewer.send({ Command::TURBO });
         }
 
-        if(ctrl && key == sf::Keyboard::Key::M)
+        if(key == sf::Keyboard::Key::Backspace && !replay)
         {
-            auto& setting = m_viewer.emulator().settings().m_memory;
-            setting = !setting;
+            m_viewer.send({ Command::REWIND, 0, press });
         }
 
-        if(ctrl && key == sf::Keyboard::Key::R)
+        if(ctrl && press && !replay)
         {
-            auto& setting = m_viewer.emulator().settings().m_vf_reset;
-            setting = !setting;
+            if(key == sf::Keyboard::Key::J) m_viewer.send({ Command::QUIRK, emu::Chip8::QUIRK_JUMPING });
+            if(key == sf::Keyboard::Key::S) m_viewer.send({ Command::QUIRK, emu::Chip8::QUIRK_SHIFTING });
+            if(key == sf::Keyboard::Key::M) m_viewer.send({ Command::QUIRK, emu::Chip8::QUIRK_MEMORY });
+            if(key == sf::Keyboard::Key::R) m_viewer.send({ Command::QUIRK, emu::Chip8::QUIRK_VF_RESET });
         }
     }
 
@@ -119,6 +127,9 @@ private:
     Viewer& m_viewer;
 };
 
+/* gray level per pixel color (plane bits; chip-8 only uses black and white) */
+constexpr std::array<sf::Uint8, 4> palette = { 0, 255, 170, 85 };
+
 }
 
 
@@ -142,23 +153,41 @@ void Viewer::run()
     auto window = detail::CBWindow(*this, "Chip-8 Emulator", mode);
 
     /* display */
-    m_display_image.create(emu::Chip8::width_res, emu::Chip8::height_res);
-    m_display_texture.loadFromImage(m_display_image);
+    m_display_texture.create(emu::Chip8::max_width_res, emu::Chip8::max_height_res);
+    m_render.m_pixels.fill(0);
+    m_display_texture.update(m_render.m_pixels.data());
     m_display_sprite.setTexture(m_display_texture);
-    m_display_sprite.setScale(16, 16);
+    m_display_sprite.setScale(m_render.m_scale / 2.0f, m_render.m_scale / 2.0f);
 
     /* Timer init */
     m_fps_counter.fps = 60;
     m_fps_counter.frames = 0;
+    m_fps_counter.last = std::chrono::steady_clock::now();
+
+    /* the emulation thread owns the emulator from here on */
+    m_audio.m_stream.play();
+    std::thread emulation(&Viewer::emulate, this);
 
     /* Main Loop */
     while(window.open())
     {
         window.clear();
-        window.pollEvents();
+
+        /* the emulation sleeps until a command arrives, so does the renderer (unless commands are still in flight) */
+        const auto& latest = m_frames.front();
+        if(latest.m_idle && latest.m_commands == m_sent)
+        {
+            window.waitEvents();
+        }
+        else
+        {
+            window.pollEvents();
+        }
 
         /* Timer and fps counter*/
-        float elapsed = 1.0 / 60.0f;
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(now - m_fps_counter.last).count();
+        m_fps_counter.last = now;
         m_fps_counter.accumTime += elapsed;
         m_fps_counter.frames++;
         if(m_fps_counter.accumTime >= 1.0)
@@ -168,32 +197,315 @@ void Viewer::run()
             m_fps_counter.frames = 0;
         }
 
-        /* update */
-        m_emulator.tick();
+        /* render (newest emulated frame, if there is one; static screens upload nothing) */
+        if(m_frames.update())
+        {
+            const auto& frame = m_frames.front();
+            upload(frame.m_display);
+
+            /* achieved speed-up (one decimal, the title only changes when the text does) */
+            std::string title = "Chip-8 Emulator";
+            if(frame.m_turbo)
+            {
+                char speedup[32];
+                std::snprintf(speedup, sizeof(speedup), " [turbo %.1fx]", frame.m_speedup);
+                title += speedup;
+            }
+
+            if(title != m_render.m_title)
+            {
+                window.title(title);
+                m_render.m_title = title;
+            }
+        }
+
+        window.draw(m_display_sprite);
+        window.display();
+    }
+
+    /* the quit command must not be dropped */
+    while(!m_commands.push({ Command::QUIT })) std::this_thread::yield();
+    emulation.join();
+    m_audio.m_stream.stop();
+
+    if(m_input.m_record) m_input.m_log.save(m_input.m_path);
+
+    if(!m_profile_path.empty() && m_emulator.profile())
+    {
+        std::ofstream file(m_profile_path);
+        m_emulator.profile()->json(file);
+        if(!file) std::cerr << "[Viewer::run] Couldn't write profile: " << m_profile_path << std::endl;
+    }
+}
+
+void Viewer::emulate()
+{
+    using Clock = Scheduler::Clock;
+    constexpr auto frame_time = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / emu::Chip8::tick_rate));
+
+    m_scheduler.reset();
+    m_turbo.m_present = m_turbo.m_window = Clock::now();
+    if(m_turbo.m_active) m_scheduler.rate(emu::Chip8::tick_rate * std::max(1, m_turbo.m_factor));
+
+    for(;;)
+    {
+        /* input of the render thread */
+        Command command;
+        while(m_commands.pop(command))
+        {
+            if(command.m_type == Command::QUIT) return;
+
+            apply(command);
+            m_applied++;
+        }
+
+        unsigned int ticks = 0;
+        if(m_turbo.m_active && m_turbo.m_factor == 0)
+        {
+            /* uncapped: tick until the next frame has to be presented (clock read every few ticks) */
+            if(!idle())
+            {
+                do
+                {
+                    for(int i = 0; i < 16; i++) update();
+                    ticks += 16;
+                } while(!idle() && Clock::now() < m_turbo.m_present);
+            }
+        }
+        else
+        {
+            /* fixed timestep at 60 hz, or the turbo multiple (catches up on missed ticks, up to a limit) */
+            ticks = m_scheduler.due();
+            for(unsigned int i = 0; i < ticks; i++)
+            {
+                update();
+            }
+        }
+
+        const bool sleep = idle();
+        const auto now = Clock::now();
+
+        /* speed-up over the last half second */
+        m_turbo.m_ticks += ticks;
+        const double window = std::chrono::duration<double>(now - m_turbo.m_window).count();
+        if(window >= 0.5)
+        {
+            m_turbo.m_speedup = m_turbo.m_ticks / window / emu::Chip8::tick_rate;
+            m_turbo.m_ticks = 0;
+            m_turbo.m_window = now;
+        }
+
+        /* fast forward skips the frames in between: at most one per display frame */
+        const bool present = !m_turbo.m_active || now >= m_turbo.m_present;
+
+        /* hand the frame to the renderer (with the dirty rows of frames it skipped) */
+        if((ticks > 0 && present) || sleep)
+        {
+            auto& display = m_emulator.display();
+            m_unread = (m_frames.pending() ? m_unread : 0) | display.m_dirty;
+            display.m_dirty = 0;
+
+            auto& frame = m_frames.back();
+            frame.m_display = display;
+            frame.m_display.m_dirty = m_unread;
+            frame.m_commands = m_applied;
+            frame.m_idle = sleep;
+            frame.m_turbo = m_turbo.m_active;
+            frame.m_speedup = m_turbo.m_speedup;
+            m_frames.publish();
+
+            /* after a stall the next frame is due one frame from now, not immediately */
+            m_turbo.m_present = std::max(m_turbo.m_present + frame_time, now);
+        }
+
+        if(sleep)
+        {
+            m_commands.wait();
+            m_scheduler.reset();
+            m_turbo.m_present = m_turbo.m_window = Clock::now();
+            m_turbo.m_ticks = 0;
+            continue;
+        }
+
+        if(!m_turbo.m_active || m_turbo.m_factor > 0) std::this_thread::sleep_until(m_scheduler.next());
+    }
+}
+
+bool Viewer::idle() const
+{
+    const auto& regs = m_emulator.regs();
+    return m_emulator.waiting() && regs.timer_delay == 0 && regs.timer_sound == 0 &&
+           !m_rewind.m_active && !m_input.m_replay;
+}
+
+void Viewer::update()
+{
+    if(m_rewind.m_active)
+    {
+        /* rewound ticks are dropped from the recording */
+        if(m_rewind.m_buffer.rewind(m_emulator))
+        {
+            m_input.m_tick--;
+            if(m_input.m_record) m_input.m_log.truncate(m_input.m_tick);
+        }
+    }
+    else
+    {
+        if(m_input.m_replay)
+        {
+            m_input.m_log.tick(m_input.m_tick, m_emulator, m_input.m_cursor);
+        }
+        else
+        {
+            if(m_input.m_record) m_input.m_log.record(m_input.m_tick, 0, m_emulator);
+            m_emulator.tick();
+        }
+
+        /* the buzzer of the tick (fast forward is silent) */
+        if(!m_turbo.m_active)
+        {
+            m_audio.m_synth.tick(m_emulator, m_audio.m_block);
+            m_audio.m_stream.push(m_audio.m_block);
+        }
+
+        m_input.m_tick++;
+        m_rewind.m_buffer.record(m_emulator);
+    }
+}
+
+void Viewer::apply(const Command& command)
+{
+    auto& settings = m_emulator.settings();
+
+    switch(command.m_type)
+    {
+    case Command::KEY:
+        m_emulator.keypad()[command.m_key] = command.m_value != 0;
+        break;
+    case Command::SPEED:
+        /* one instruction per tick */
+        if(settings.m_speed > 0) settings.m_speed = std::max(emu::Chip8::tick_rate, settings.m_speed + emu::Chip8::tick_rate * command.m_value);
+        else settings.m_cycles = std::max(1, settings.m_cycles + command.m_value);
+        break;
+    case Command::QUIRK:
+        if(command.m_key == emu::Chip8::QUIRK_JUMPING) settings.m_jumping = !settings.m_jumping;
+        if(command.m_key == emu::Chip8::QUIRK_SHIFTING) settings.m_shifting = !settings.m_shifting;
+        if(command.m_key == emu::Chip8::QUIRK_MEMORY) settings.m_memory = !settings.m_memory;
+        if(command.m_key == emu::Chip8::QUIRK_VF_RESET) settings.m_vf_reset = !settings.m_vf_reset;
+        break;
+    case Command::REWIND:
+        m_rewind.m_active = command.m_value != 0;
+        break;
+    case Command::TURBO:
+        /* uncapped turbo does not use the scheduler, it restarts at 60 hz when turbo ends */
+        m_turbo.m_active = !m_turbo.m_active;
+        m_scheduler.rate(emu::Chip8::tick_rate * (m_turbo.m_active ? std::max(1, m_turbo.m_factor) : 1));
+        m_scheduler.reset();
+        m_turbo.m_present = m_turbo.m_window = Scheduler::Clock::now();
+        m_turbo.m_ticks = 0;
+        break;
+    case Command::PRINT:
+    {
+        /* instructions per second of emulated time (ticks at the measured tick rate) */
+        const double seconds = m_scheduler.measured_rate() > 0.0 ? m_scheduler.steps() / m_scheduler.measured_rate() : 0.0;
+        std::cout << m_emulator << m_rewind.m_buffer << m_scheduler << m_audio.m_stream
+                  << "speed: " << (seconds > 0.0 ? m_emulator.instructions() / seconds : 0.0) << " hz" << std::endl;
+        if(const auto* profile = m_emulator.profile()) profile->report(std::cout);
+        break;
+    }
+    case Command::QUIT:
+    default:
+        break;
+    }
+}
+
+void Viewer::upload(const emu::Chip8::Display& display)
+{
+    constexpr int stride = 4 * emu::Chip8::max_width_res;
+
+    /* lores rows and pixels are doubled */
+    const int width = display.width();
+    const int scale = emu::Chip8::max_width_res / width;
+
+    auto dirty = display.m_dirty & (~emu::uint64(0) >> (64 - display.height()));
+    while(dirty)
+    {
+        /* next run of dirty rows [first, last) */
+        const int first = std::countr_zero(dirty);
+        const int last = first + std::countr_one(dirty >> first);
+        dirty &= last < 64 ? ~emu::uint64(0) << last : 0;
 
-        /* render */
+        for(int y = first; y < last; y++)
         {
-            const auto& display = m_emulator.display();
+            auto* pixel = m_render.m_pixels.data() + y * scale * stride;
 
-            for(int y = 0; y < emu::Chip8::height_res; y++)
+            for(int x = 0; x < width; x++)
             {
-                for(int x = 0; x < emu::Chip8::width_res; x++)
+                const sf::Uint8 value = detail::palette[display.color(x, y)];
+                for(int s = 0; s < scale; s++, pixel += 4)
                 {
-                    m_display_image.setPixel(x, y,
-                                             display[x + y*emu::Chip8::width_res] ?
-                                sf::Color{255, 255, 255} : sf::Color{0, 0, 0});
+                    pixel[0] = pixel[1] = pixel[2] = value;
+                    pixel[3] = 255;
                 }
             }
 
-            m_display_texture.loadFromImage(m_display_image);
-            window.draw(m_display_sprite);
+            /* second texel row of a lores row */
+            if(scale > 1) std::copy_n(pixel - stride, stride, pixel);
         }
 
-        window.display();
+        m_display_texture.update(m_render.m_pixels.data() + first * scale * stride, emu::Chip8::max_width_res,
+                                 (last - first) * scale, 0, first * scale);
     }
 }
 
+void Viewer::send(const Command& command)
+{
+    if(!m_commands.push(command))
+    {
+        std::cerr << "[Viewer::send] Command queue full, input dropped!" << std::endl;
+        return;
+    }
+
+    m_sent++;
+}
+
+void Viewer::turbo(int factor, bool active)
+{
+    m_turbo.m_factor = std::max(0, factor);
+    m_turbo.m_active = active;
+}
+
+void Viewer::audio_latency(double seconds)
+{
+    m_audio.m_stream.latency_bound(seconds);
+}
+
+void Viewer::profile(const std::filesystem::path& path)
+{
+    m_profile_path = path;
+}
+
 emu::Chip8& Viewer::emulator()
 {
     return m_emulator;
 }
+
+void Viewer::record(const std::filesystem::path& path, emu::uint32 seed)
+{
+    m_emulator.seed(seed);
+    m_input.m_log.begin(m_emulator, seed);
+    m_input.m_path = path;
+    m_input.m_record = true;
+    m_input.m_replay = false;
+}
+
+bool Viewer::replay(const std::filesystem::path& path)
+{
+    if(!m_input.m_log.load(path)) return false;
+
+    m_input.m_log.prepare(m_emulator);
+    m_input.m_cursor = 0;
+    m_input.m_replay = true;
+    m_input.m_record = false;
+    return true;
+}
@@ -1,7 +1,18 @@
 #pragma once
 
 #include <chip8/chip8.h>
+#include <chip8/input_log.h>
+#include <chip8/rewind.h>
+#include <chip8/synth.h>
 
+#include "audio_stream.h"
+#include "scheduler.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+#include <array>
+#include <chrono>
+#include <filesystem>
 #include <string>
 #include <functional>
 
@@ -10,12 +21,25 @@
 /*
  * Emulator Viewer
  *  -> minimalistic viewer of chip8 display and input handling
- *  -> access Chip8 with auto& emu = emulator(); to load rom and change settings
+ *  -> access Chip8 with auto& emu = emulator(); to load rom and change settings (before run())
+ *  -> while the rom waits for a key (FX0A) and the timers are stopped, both threads sleep until the next window event
+ *
+ *  Threads:
+ *  ---------------------------------
+ *    emulation: ticks the Chip8 on its own 60 Hz clock (fixed timestep Scheduler, catches up to 5 missed ticks),
+ *               owns emulator, rewind buffer and input log while running
+ *    render:    the caller of run(); polls window events and draws the newest frame (SFML 60 fps limiter)
+ *    audio:     SFML's streaming thread plays the buzzer the emulation renders per tick (emu::Synth)
+ *
+ *    -> frames are handed to the renderer through a triple buffer (neither side waits for the other)
+ *    -> keypad and control keys are sent to the emulation through an SPSC queue (applied at the start of a tick)
+ *    -> samples are handed to the audio stream through an SPSC ring (fast forward and rewind are silent)
  *
  *  Resolution:
  *  ---------------------------------
- *    chip 8: 64 x 32
+ *    chip 8: 64 x 32 (SUPER-CHIP hires: 128 x 64; XO-CHIP: four gray levels from two planes)
  *    window: chip 8 * 16px = 1024 x 512
+ *    texture: always 128 x 64, lores pixels are uploaded as 2 x 2 texels (the window keeps its size on a switch)
  *
  *  Input-Mapping:
  *  ---------------------------------
@@ -31,12 +55,20 @@
  *   PAGE_DOWN: decrease resolution
  *   +: increase speed
  *   -: decrease speed
- *   space: print display and registers of chip8 emu to stdout
+ *   space: print display, registers, rewind budget, measured speed, audio latency (and the execution profile
+ *          of CHIP8_PROFILE builds) to stdout
+ *   backspace (hold): rewind, one recorded frame per frame (not while replaying)
+ *   tab: toggle fast forward (multiple set with turbo(), default: as fast as possible; speed-up shown in the title)
  *   ctrl + J: jump quirk
  *   ctrl + M: memory quirk
  *   ctrl + S: shifting quirk
  *   ctrl + R: VF reset quirk
  *
+ *  Input logs:
+ *  ---------------------------------
+ *    record() logs keypad and settings changes per tick (written when the window is closed),
+ *    replay() plays a log back bit-exactly; keypad, speed and quirk keys are ignored while replaying
+ *
  *
  *  -----------------------------
  *  @author Nikolaus Rauch
@@ -54,23 +86,132 @@ public:
     /* access chip8 emulator */
     emu::Chip8& emulator();
 
+    /* record an input log (call after loading the rom and settings; seeds the emulator) */
+    void record(const std::filesystem::path& path, emu::uint32 seed);
+
+    /* replay an input log (call after loading the rom; seed and settings are taken from the log) */
+    bool replay(const std::filesystem::path& path);
+
+    /* fast forward multiple (0: as fast as the host allows) and whether it starts active (call before run()) */
+    void turbo(int factor, bool active);
+
+    /* bound of the audio latency in seconds (default 25 ms, see AudioStream; call before run()) */
+    void audio_latency(double seconds);
+
+    /* write the execution profile as JSON when the window is closed (CHIP8_PROFILE builds) */
+    void profile(const std::filesystem::path& path);
+
 private:
     struct
     {
         double accumTime;
         double fps;
         unsigned int frames;
+        std::chrono::steady_clock::time_point last;
     } m_fps_counter;
 
     struct
     {
-        int m_scale = 16;
+        int m_scale = 16;               /* window pixels per lores pixel */
+        std::string m_title;
+        std::array<sf::Uint8, emu::Chip8::max_width_res * emu::Chip8::max_height_res * 4> m_pixels;    /* RGBA of the texture */
     } m_render;
 
+    /* render -> emulation */
+    struct Command
+    {
+        enum eType : emu::uint8
+        {
+            KEY,        /* m_key pressed (m_value != 0) or released */
+            SPEED,      /* add m_value to the cycles per tick */
+            QUIRK,      /* toggle the eQuirk bit m_key */
+            REWIND,     /* rewind while m_value != 0 */
+            TURBO,      /* toggle fast forward */
+            PRINT,      /* print display, registers and rewind budget */
+            QUIT
+        };
+
+        eType m_type;
+        emu::uint8 m_key = 0;
+        int m_value = 0;
+    };
+
+    /* emulation -> render */
+    struct Frame
+    {
+        emu::Chip8::Display m_display;  /* m_dirty: rows changed since the last frame the renderer picked up */
+        emu::uint64 m_commands = 0;     /* commands applied before this frame */
+        bool m_idle = false;            /* emulation sleeps until the next command (FX0A wait, timers stopped) */
+        bool m_turbo = false;
+        double m_speedup = 1.0;         /* measured ticks per second / 60 */
+    };
+
+    /* emulation thread: run the due ticks, publish frame, sleep until the next tick is due */
+    void emulate();
+    void update();
+    void apply(const Command& command);
+
+    /* FX0A waits for a key with the timers stopped: no tick changes anything until a command arrives */
+    bool idle() const;
+
+    /* render thread: queue a command for the next tick */
+    void send(const Command& command);
+
+    /* render thread: convert the dirty rows of display and upload them (one texture update per run of rows) */
+    void upload(const emu::Chip8::Display& display);
+
+    /* fast forward: ticks run at m_factor times 60 hz (0: uncapped, as many ticks as fit into a display frame),
+     * frames are published at most at 60 hz (the ones in between are skipped) */
+    struct
+    {
+        int m_factor = 0;
+        bool m_active = false;
+        Scheduler::Clock::time_point m_present;     /* next frame to publish */
+
+        /* speed-up measurement */
+        Scheduler::Clock::time_point m_window;
+        emu::uint64 m_ticks = 0;
+        double m_speedup = 1.0;
+    } m_turbo;
+
+    /* every tick is recorded, holding backspace steps back instead of ticking */
+    struct
+    {
+        emu::Rewind m_buffer;
+        bool m_active = false;
+    } m_rewind;
+
+    /* the buzzer of every tick, streamed to the audio device */
+    struct
+    {
+        emu::Synth m_synth;
+        emu::Synth::Block m_block;
+        AudioStream m_stream;
+    } m_audio;
+
+    struct
+    {
+        emu::InputLog m_log;
+        std::filesystem::path m_path;
+        bool m_record = false;
+        bool m_replay = false;
+        emu::uint64 m_tick = 0;         /* ticks executed */
+        std::size_t m_cursor = 0;       /* next replayed event */
+    } m_input;
+
+    std::filesystem::path m_profile_path;
+
 private:
     emu::Chip8 m_emulator;
 
-    sf::Image m_display_image;
+    Scheduler m_scheduler{ emu::Chip8::tick_rate };
+
+    SpscQueue<Command, 256> m_commands;
+    emu::uint64 m_sent = 0;             /* commands queued by the render thread */
+    emu::uint64 m_applied = 0;          /* commands applied by the emulation thread */
+    emu::uint64 m_unread = 0;           /* dirty rows of published frames the renderer has not picked up */
+    TripleBuffer<Frame> m_frames;
+
     sf::Texture m_display_texture;
     sf::Sprite m_display_sprite;
 
@@ -95,54 +95,67 @@ void Window::pollEvents()
     sf::Event event;
     while(mRenderWindow.pollEvent(event))
     {
-        switch(event.type)
-        {
-        case sf::Event::Closed:
-            mStatus &= ~eStatus::OPEN;
-            close();
-            break;
-        case sf::Event::Resized:
-        {
-            mCurrentMode.mWidth = event.size.width;
-            mCurrentMode.mHeight = event.size.height;
-            onResize(event.size.width, event.size.height);
-            break;
-        }
-        case sf::Event::GainedFocus:
-            mStatus |= eStatus::FOCUSED;
-            break;
-        case sf::Event::LostFocus:
-            mStatus &= ~eStatus::FOCUSED;
-            break;
-        case sf::Event::KeyPressed:
-            onKey(event.key.code, event.key.control, true);
-            break;
-        case sf::Event::KeyReleased:
-            onKey(event.key.code, event.key.control, false);
-            break;
-        case sf::Event::TextEntered:
-            onChar(event.text.unicode);
-            break;
-        case sf::Event::MouseEntered:
-            break;
-        case sf::Event::MouseLeft:
-            break;
-        case sf::Event::MouseMoved:
-            break;
-        case sf::Event::MouseButtonPressed:
-            onMouseButton(event.mouseButton.x, event.mouseButton.y, event.mouseButton.button, 0, true);
-            break;
-        case sf::Event::MouseButtonReleased:
-            onMouseButton(event.mouseButton.x, event.mouseButton.y, event.mouseButton.button, 0, false);
-            break;
-        case sf::Event::MouseWheelScrolled:
-            onMouseScroll(event.mouseWheelScroll.delta);
-        default: break;
-        }
+        handleEvent(event);
     }
 
 }
 
+void Window::waitEvents()
+{
+    sf::Event event;
+    if(mRenderWindow.waitEvent(event)) handleEvent(event);
+
+    pollEvents();
+}
+
+void Window::handleEvent(const sf::Event& event)
+{
+    switch(event.type)
+    {
+    case sf::Event::Closed:
+        mStatus &= ~eStatus::OPEN;
+        close();
+        break;
+    case sf::Event::Resized:
+    {
+        mCurrentMode.mWidth = event.size.width;
+        mCurrentMode.mHeight = event.size.height;
+        onResize(event.size.width, event.size.height);
+        break;
+    }
+    case sf::Event::GainedFocus:
+        mStatus |= eStatus::FOCUSED;
+        break;
+    case sf::Event::LostFocus:
+        mStatus &= ~eStatus::FOCUSED;
+        break;
+    case sf::Event::KeyPressed:
+        onKey(event.key.code, event.key.control, true);
+        break;
+    case sf::Event::KeyReleased:
+        onKey(event.key.code, event.key.control, false);
+        break;
+    case sf::Event::TextEntered:
+        onChar(event.text.unicode);
+        break;
+    case sf::Event::MouseEntered:
+        break;
+    case sf::Event::MouseLeft:
+        break;
+    case sf::Event::MouseMoved:
+        break;
+    case sf::Event::MouseButtonPressed:
+        onMouseButton(event.mouseButton.x, event.mouseButton.y, event.mouseButton.button, 0, true);
+        break;
+    case sf::Event::MouseButtonReleased:
+        onMouseButton(event.mouseButton.x, event.mouseButton.y, event.mouseButton.button, 0, false);
+        break;
+    case sf::Event::MouseWheelScrolled:
+        onMouseScroll(event.mouseWheelScroll.delta);
+    default: break;
+    }
+}
+
 static Window* gLastActiveContext = nullptr;
 void Window::makeCurrent()
 {
@@ -107,6 +107,7 @@ public:
     void close();
 
     void pollEvents();
+    void waitEvents();  /* blocks until an event arrives, then handles all pending */
     void makeCurrent();
 
     void display();
@@ -136,6 +137,9 @@ public:
     virtual void onMouseScroll(double delta);
     virtual void onResize(int width, int height);
 
+private:
+    void handleEvent(const sf::Event& event);
+
 private:
     sf::RenderWindow    mRenderWindow;
     VideoMode           mCurrentMode;